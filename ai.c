@@ -0,0 +1,245 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The autoplayer: it drops the falling shape in every column and
+ * orientation on a copy of the board's occupancy words, then does the same
+ * with the next shape on each result, and keeps the first placement that
+ * leads to the best scored board.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "ai.h"
+#include "heuristic.h"
+
+#define ROWS (BOARD_HEIGHT + BOARD_FLOOR)
+
+static int drop(const uint32_t rows[], int type, int angle, int x, int y);
+static double evaluate(const Boards *boards, const int lines[], const Weights *weights, double best);
+static int place(uint32_t rows[], int type, int angle, int x, int y);
+static int surface(const uint32_t rows[]);
+
+// well known weights for this set of features
+const Weights ai_weights = { -0.510066, 0.760666, -0.35663, -0.184483 };
+
+// orientations that differ by more than a shift, per type
+static const int orientations[7] = { 4, 2, 4, 1, 2, 4, 2 };
+
+// the input that brings the falling shape closer to target: turn first, then shift, then drop
+int ai_input(const Game *game, const Placement *target) {
+  const Shape *s = &game->falling;
+  int turns = (target->angle - s->angle) & 3;
+  if (turns == 3)
+    return INPUT_CCW;
+  if (turns != 0)
+    return INPUT_CW;
+  if (s->x > target->x)
+    return INPUT_LEFT;
+  if (s->x < target->x)
+    return INPUT_RIGHT;
+  return INPUT_DROP;
+}
+
+/*
+ * Plays a game out without a display, searching once per shape and steering
+ * through game_step() like a player would, until the game is lost or more
+ * than pieces shapes have spawned. Returns the lines cleared.
+ */
+int ai_play(Game *game, const Weights *weights, int pieces) {
+  Placement target;
+  int planned = -1;
+  while (game->over == 0 && game->pieces <= pieces) {
+    if (game->pieces != planned) {
+      ai_search(game, weights, &target);
+      planned = game->pieces;
+    }
+    game_step(game, ai_input(game, &target));
+  }
+  return game->lines;
+}
+
+/*
+ * Finds the best placement for the falling shape, looking one shape ahead,
+ * and returns how many boards it scored. best->score is -HUGE_VAL when the
+ * shape fits nowhere.
+ */
+long ai_search(const Game *game, const Weights *weights, Placement *best) {
+  uint32_t first[ROWS], second[ROWS];
+  Boards boards;
+  int lines[BATCH_MAX];
+  int type, next, angle, x, y, cleared, angle2, x2, y2, r, start, start2;
+  double score;
+  long evaluated;
+  type = game->falling.type;
+  next = game->queue[0];
+  evaluated = 0;
+  // if nothing fits, the shape is left where it is
+  best->angle = game->falling.angle;
+  best->x = game->falling.x;
+  best->score = -HUGE_VAL;
+  // drops start as low as they can while every row of the box is still empty
+  start = (surface(game->board.rows) - 4) * BLOCK_SIZE;
+  if (start < game->falling.y / BLOCK_SIZE * BLOCK_SIZE)
+    start = game->falling.y / BLOCK_SIZE * BLOCK_SIZE;
+  // a shape kicked up past the top has y < 0, but drop() reads rows from start
+  if (start < 0)
+    start = 0;
+  angle = 0;
+  while (angle < orientations[type]) {
+    x = -3;
+    while (x < BOARD_WIDTH) {
+      y = drop(game->board.rows, type, angle, x, start);
+      if (y >= 0) {
+        memcpy(first, game->board.rows, sizeof(first));
+        cleared = place(first, type, angle, x, y);
+        start2 = (surface(first) - 4) * BLOCK_SIZE;
+        if (start2 < 0)
+          start2 = 0;
+        // the next shape's boards are scored in batches, none higher than where it drops from
+        score = -HUGE_VAL;
+        boards.n = 0;
+        boards.top = start2 / BLOCK_SIZE;
+        angle2 = 0;
+        while (angle2 < orientations[next]) {
+          x2 = -3;
+          while (x2 < BOARD_WIDTH) {
+            y2 = drop(first, next, angle2, x2, start2);
+            if (y2 >= 0) {
+              memcpy(second, first, sizeof(second));
+              lines[boards.n] = cleared + place(second, next, angle2, x2, y2);
+              r = boards.top;
+              while (r < BOARD_HEIGHT) {
+                boards.rows[r][boards.n] = second[r];
+                ++r;
+              }
+              if (++boards.n == BATCH_MAX) {
+                score = evaluate(&boards, lines, weights, score);
+                evaluated += boards.n;
+                boards.n = 0;
+              }
+            }
+            ++x2;
+          }
+          ++angle2;
+        }
+        if (boards.n > 0) {
+          score = evaluate(&boards, lines, weights, score);
+          evaluated += boards.n;
+        }
+        if (score == -HUGE_VAL) { // the next shape would not even spawn
+          boards.n = 1;
+          boards.top = 0;
+          r = 0;
+          while (r < BOARD_HEIGHT) {
+            boards.rows[r][0] = first[r];
+            ++r;
+          }
+          lines[0] = cleared;
+          score = evaluate(&boards, lines, weights, -HUGE_VAL) - 1e6;
+          ++evaluated;
+        }
+        if (score > best->score) {
+          best->angle = angle;
+          best->x = x;
+          best->score = score;
+        }
+      }
+      ++x;
+    }
+    ++angle;
+  }
+  return evaluated;
+}
+
+// where a shape put at y lands, cell by cell, or -1 if it does not fit at y
+static int drop(const uint32_t rows[], int type, int angle, int x, int y) {
+  const uint8_t *mask = shape_mask(type, angle);
+  uint32_t m0, m1, m2, m3;
+  int r;
+  // y is on a row here, so unlike shape_collides() each box row meets one board row
+  m0 = (uint32_t) mask[0] << (x + BOARD_WALL);
+  m1 = (uint32_t) mask[1] << (x + BOARD_WALL);
+  m2 = (uint32_t) mask[2] << (x + BOARD_WALL);
+  m3 = (uint32_t) mask[3] << (x + BOARD_WALL);
+  r = y / BLOCK_SIZE;
+  if ((rows[r] & m0) | (rows[r + 1] & m1) | (rows[r + 2] & m2) | (rows[r + 3] & m3))
+    return -1;
+  while (((rows[r + 1] & m0) | (rows[r + 2] & m1) | (rows[r + 3] & m2) | (rows[r + 4] & m3)) == 0)
+    ++r;
+  return r * BLOCK_SIZE;
+}
+
+// the best of best and the scores of a batch of boards, lines[i] being the lines cleared to reach board i
+static double evaluate(const Boards *boards, const int lines[], const Weights *weights, double best) {
+  Features features;
+  double score;
+  int i;
+  features_batch(boards, &features);
+  i = 0;
+  while (i < boards->n) {
+    score = weights->height * features.height[i] + weights->lines * lines[i] + weights->holes * features.holes[i] +
+      weights->bumpiness * features.bumpiness[i];
+    if (score > best)
+      best = score;
+    ++i;
+  }
+  return best;
+}
+
+// locks a shape into the rows and clears the full ones, returning how many
+static int place(uint32_t rows[], int type, int angle, int x, int y) {
+  const uint8_t *mask = shape_mask(type, angle);
+  int i, n, r, top, bottom;
+  top = y / BLOCK_SIZE;
+  i = 0;
+  while (i < 4) {
+    rows[top + i] |= (uint32_t) mask[i] << (x + BOARD_WALL);
+    ++i;
+  }
+  bottom = (top + 3 < BOARD_HEIGHT) ? top + 3 : BOARD_HEIGHT - 1;
+  n = 0;
+  r = bottom;
+  while (r >= top) {
+    if (rows[r] == ROW_FULL)
+      ++n;
+    else if (n > 0)
+      rows[r + n] = rows[r];
+    --r;
+  }
+  if (n > 0) {
+    memmove(&rows[n], &rows[0], top * sizeof(rows[0]));
+    r = 0;
+    while (r < n)
+      rows[r++] = ROW_EMPTY;
+  }
+  return n;
+}
+
+// the first row from the top with a filled cell, BOARD_HEIGHT if none
+static int surface(const uint32_t rows[]) {
+  int r = 0;
+  while (r < BOARD_HEIGHT && rows[r] == ROW_EMPTY)
+    ++r;
+  return r;
+}
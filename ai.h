@@ -0,0 +1,48 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AI_H
+#define AI_H
+
+#include "engine.h"
+
+// how much each board feature counts in a placement's score
+typedef struct Weights {
+  double height;
+  double lines;
+  double holes;
+  double bumpiness;
+} Weights;
+
+// where the falling shape should lock: its angle and the column of its box
+typedef struct Placement {
+  int angle, x;
+  double score;
+} Placement;
+
+extern const Weights ai_weights;
+
+int ai_input(const Game *game, const Placement *target);
+int ai_play(Game *game, const Weights *weights, int pieces);
+long ai_search(const Game *game, const Weights *weights, Placement *best);
+
+#endif
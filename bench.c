@@ -0,0 +1,405 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the engine's hot paths, one JSON object per line:
+ *   {"name": "move_left", "ops": 2560000, "ns_per_op": 3.21, "allocs_per_op": 0}
+ * Each case prepares a batch of identical games outside the clock, then
+ * times its operation once on each of them, until enough time has passed.
+ * Allocations are malloc(), calloc() and realloc() calls made by the engine
+ * during the timed part, counted through the linker's --wrap.
+ * Naming cases on the command line runs only those.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ai.h"
+#include "blit.h"
+#include "heuristic.h"
+
+// games prepared per round, and how long each case runs for at least
+#define GAMES 256
+#define MIN_NS 200000000
+
+#define NBOARDS 1024
+
+typedef struct Case {
+  const char *name;
+  int arg;
+  // builds the game the operation starts from
+  void (*prepare)(Game *game, int arg);
+  void (*op)(Game *game, int arg);
+} Case;
+
+void *__real_calloc(size_t n, size_t size);
+void *__real_malloc(size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__wrap_calloc(size_t n, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_realloc(void *p, size_t size);
+
+static void check_tops(const Game *game, int i);
+static void measure(const Case *c);
+static long long now();
+static void op_ai_search(Game *game, int arg);
+static void op_blit_board(Game *game, int arg);
+static void op_board_features(Game *game, int arg);
+static void op_clear_lines(Game *game, int arg);
+static void op_falling_next(Game *game, int arg);
+static void op_features_batch(Game *game, int arg);
+static void op_flip(Game *game, int arg);
+static void op_move_left(Game *game, int arg);
+static void op_move_right(Game *game, int arg);
+static void op_fall_to_rest(Game *game, int arg);
+static void op_shape_drop(Game *game, int arg);
+static void op_shape_fall(Game *game, int arg);
+static void op_shape_landing(Game *game, int arg);
+static void op_shape_new(Game *game, int arg);
+static void prepare_boards();
+static void prepare_frame();
+static void prepare_full_board(Game *game, int arg);
+static void prepare_full_rows(Game *game, int arg);
+static void prepare_landed(Game *game, int arg);
+static void prepare_midgame(Game *game, int arg);
+
+static long allocs;
+static Game midgame;
+// boards from an AI game, one by one and as batches of BATCH_MAX
+static uint32_t boards[NBOARDS][BOARD_HEIGHT + BOARD_FLOOR];
+static Boards batches[NBOARDS / BATCH_MAX];
+static Features features;
+static int board;
+// a wall sized frame, and tiles of a shade per type
+static uint32_t pixels[WALL_HEIGHT * WALL_WIDTH];
+static uint32_t tiles[7][TILE_PIXELS];
+static Frame frame = { pixels, WALL_WIDTH, 0, 0, WALL_WIDTH, WALL_HEIGHT };
+
+static const Case cases[] = {
+  { "move_left", 0, prepare_midgame, op_move_left },
+  { "move_right", 0, prepare_midgame, op_move_right },
+  { "shape_flip", 1, prepare_midgame, op_flip },
+  { "shape_fall", 0, prepare_midgame, op_shape_fall },
+  { "shape_fall_lock", 0, prepare_landed, op_shape_fall },
+  { "shape_landing", 0, prepare_midgame, op_shape_landing },
+  { "shape_drop", 0, prepare_midgame, op_shape_drop },
+  { "fall_to_rest", 0, prepare_midgame, op_fall_to_rest },
+  { "clear_lines_1", 1, prepare_full_rows, op_clear_lines },
+  { "clear_lines_2", 2, prepare_full_rows, op_clear_lines },
+  { "clear_lines_3", 3, prepare_full_rows, op_clear_lines },
+  { "clear_lines_4", 4, prepare_full_rows, op_clear_lines },
+  { "shape_new", 0, prepare_midgame, op_shape_new },
+  { "falling_next", 0, prepare_midgame, op_falling_next },
+  { "board_features", 0, prepare_midgame, op_board_features },
+  { "features_batch_32", 0, prepare_midgame, op_features_batch },
+  { "ai_search", 0, prepare_midgame, op_ai_search },
+  { "blit_board_full", 0, prepare_full_board, op_blit_board }
+};
+
+int main(int argc, char **argv) {
+  int i, j;
+  blit_init();
+  prepare_boards();
+  prepare_frame();
+  i = 0;
+  while (i < (int) (sizeof(cases) / sizeof(cases[0]))) {
+    j = 1;
+    while (j < argc && strcmp(argv[j], cases[i].name) != 0)
+      ++j;
+    if (argc == 1 || j < argc)
+      measure(&cases[i]);
+    ++i;
+  }
+  return 0;
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  ++allocs;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_malloc(size_t size) {
+  ++allocs;
+  return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  ++allocs;
+  return __real_realloc(p, size);
+}
+
+// the kept tops must be the ones the rows give, and the landing where falling stops
+static void check_tops(const Game *game, int i) {
+  Board board = game->board;
+  const Shape *s = &game->falling;
+  int y;
+  board_tops(&board);
+  if (memcmp(board.tops, game->board.tops, sizeof(board.tops)) != 0) {
+    fprintf(stderr, "benchmark: board %d: tops are out of date\n", i);
+    exit(1);
+  }
+  y = s->y;
+  while (shape_collides(board.rows, s->type, s->angle, s->x, y + FALL_STEP) == 0)
+    y += FALL_STEP;
+  if (game->over == 0 && shape_landing(game) != y) {
+    fprintf(stderr, "benchmark: board %d: shape_landing() says %d, falling stops at %d\n", i, shape_landing(game), y);
+    exit(1);
+  }
+}
+
+static void measure(const Case *c) {
+  static Game games[GAMES];
+  long long start, ns;
+  long ops, counted;
+  int i;
+  ns = 0;
+  ops = 0;
+  counted = 0;
+  while (ns < MIN_NS) {
+    c->prepare(&games[0], c->arg);
+    i = 1;
+    while (i < GAMES)
+      memcpy(&games[i++], &games[0], sizeof(Game));
+    allocs = 0;
+    start = now();
+    i = 0;
+    while (i < GAMES)
+      c->op(&games[i++], c->arg);
+    ns += now() - start;
+    counted += allocs;
+    ops += GAMES;
+  }
+  printf("{\"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.2f, \"allocs_per_op\": %g}\n", c->name, ops,
+    (double) ns / ops, (double) counted / ops);
+  fflush(stdout);
+}
+
+static long long now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (long long) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void op_ai_search(Game *game, int arg) {
+  Placement best;
+  ai_search(game, &ai_weights, &best);
+}
+
+static void op_blit_board(Game *game, int arg) {
+  blit_board(&frame, &game->board, tiles);
+}
+
+static void op_board_features(Game *game, int arg) {
+  board_features(boards[board++ % NBOARDS], &features, 0);
+}
+
+static void op_clear_lines(Game *game, int arg) {
+  int cleared[4];
+  clear_lines(game, BOARD_HEIGHT - 4, cleared);
+}
+
+static void op_falling_next(Game *game, int arg) {
+  falling_next(game);
+}
+
+static void op_features_batch(Game *game, int arg) {
+  features_batch(&batches[board++ % (NBOARDS / BATCH_MAX)], &features);
+}
+
+static void op_flip(Game *game, int arg) {
+  shape_flip(game, arg);
+}
+
+static void op_move_left(Game *game, int arg) {
+  move_left(game);
+}
+
+static void op_move_right(Game *game, int arg) {
+  move_right(game);
+}
+
+// what a hard drop used to take: the shape falls a pixel at a time until it locks
+static void op_fall_to_rest(Game *game, int arg) {
+  int locked = 0;
+  while (locked == 0)
+    locked = shape_fall(game);
+}
+
+static void op_shape_drop(Game *game, int arg) {
+  shape_drop(game);
+}
+
+static void op_shape_fall(Game *game, int arg) {
+  shape_fall(game);
+}
+
+static void op_shape_landing(Game *game, int arg) {
+  shape_landing(game);
+}
+
+static void op_shape_new(Game *game, int arg) {
+  shape_new(game);
+}
+
+/*
+ * The midgame position, and snapshots of the AI's game after each shape for
+ * the feature kernel; a batch starts at the highest surface among its
+ * boards, as in ai_search().
+ */
+static void prepare_boards() {
+  Game game;
+  Boards *batch;
+  Features batched;
+  int i, r;
+  game_new(&midgame, 1, RANDOM_BAG);
+  ai_play(&midgame, &ai_weights, 60);
+  game_new(&game, 1, RANDOM_BAG);
+  i = 0;
+  while (i < NBOARDS) {
+    if (game.over == 1)
+      game_new(&game, i, RANDOM_BAG);
+    ai_play(&game, &ai_weights, game.pieces);
+    check_tops(&game, i);
+    memcpy(boards[i], game.board.rows, sizeof(boards[0]));
+    batch = &batches[i / BATCH_MAX];
+    if (i % BATCH_MAX == 0) {
+      batch->n = BATCH_MAX;
+      batch->top = BOARD_HEIGHT;
+    }
+    r = 0;
+    while (r < BOARD_HEIGHT) {
+      batch->rows[r][i % BATCH_MAX] = game.board.rows[r];
+      if (game.board.rows[r] != ROW_EMPTY && r < batch->top)
+        batch->top = r;
+      ++r;
+    }
+    ++i;
+  }
+  // both kernels must agree before their times mean anything
+  i = 0;
+  while (i < NBOARDS) {
+    if (i % BATCH_MAX == 0)
+      features_batch(&batches[i / BATCH_MAX], &batched);
+    board_features(boards[i], &features, 0);
+    r = i % BATCH_MAX;
+    if (batched.height[r] != features.height[0] || batched.holes[r] != features.holes[0] ||
+      batched.transitions[r] != features.transitions[0] || batched.bumpiness[r] != features.bumpiness[0]) {
+      fprintf(stderr, "benchmark: board %d: batched and single features differ\n", i);
+      exit(1);
+    }
+    ++i;
+  }
+}
+
+/*
+ * The tiles, and a check that a board drawn through a frame that cuts
+ * cells in every direction matches one drawn pixel by pixel.
+ */
+static void prepare_frame() {
+  Game game;
+  Frame cut = { pixels + 7 * WALL_WIDTH + 13, WALL_WIDTH, 13, 7, WALL_WIDTH - 29, WALL_HEIGHT - 18 };
+  uint32_t expected;
+  int i, x, y, cell;
+  i = 0;
+  while (i < 7 * TILE_PIXELS) {
+    tiles[i / TILE_PIXELS][i % TILE_PIXELS] = i * 2654435761u;
+    ++i;
+  }
+  prepare_full_board(&game, 0);
+  memset(pixels, 0, sizeof(pixels));
+  blit_board(&cut, &game.board, tiles);
+  i = 0;
+  while (i < WALL_HEIGHT * WALL_WIDTH) {
+    x = i % WALL_WIDTH;
+    y = i / WALL_WIDTH;
+    cell = board_cell(&game.board, x / BLOCK_SIZE, y / BLOCK_SIZE);
+    expected = 0;
+    if (x >= cut.x && x < cut.x + cut.w && y >= cut.y && y < cut.y + cut.h)
+      expected = tiles[cell - 1][y % BLOCK_SIZE * BLOCK_SIZE + x % BLOCK_SIZE];
+    if (pixels[i] != expected) {
+      fprintf(stderr, "benchmark: blit_board: pixel %d, %d is wrong\n", x, y);
+      exit(1);
+    }
+    ++i;
+  }
+}
+
+// every cell filled, as the drawing's worst case
+static void prepare_full_board(Game *game, int arg) {
+  int x, y;
+  game_new(game, 1, RANDOM_BAG);
+  y = 0;
+  while (y < BOARD_HEIGHT) {
+    game->board.rows[y] = ROW_FULL;
+    x = 0;
+    while (x < BOARD_WIDTH) {
+      board_set(&game->board, x, y, 1 + (x + y) % 7);
+      ++x;
+    }
+    ++y;
+  }
+  board_tops(&game->board);
+}
+
+// the bottom rows: arg full ones, then one with a gap, over a few scattered cells
+static void prepare_full_rows(Game *game, int arg) {
+  int full, r, x;
+  game_new(game, 1, RANDOM_BAG);
+  r = BOARD_HEIGHT - 8;
+  while (r < BOARD_HEIGHT) {
+    x = 0;
+    while (x < BOARD_WIDTH) {
+      if (r >= BOARD_HEIGHT - arg || (r == BOARD_HEIGHT - arg - 1 && x != 3) ||
+        (r < BOARD_HEIGHT - arg - 1 && (x * 7 + r) % 3 == 0)) {
+        game->board.rows[r] |= 1u << (x + BOARD_WALL);
+        board_set(&game->board, x, r, 1 + (x + r) % 7);
+      }
+      ++x;
+    }
+    ++r;
+  }
+  board_tops(&game->board);
+  // clear_lines_<arg> has to clear exactly arg of them
+  full = 0;
+  r = 0;
+  while (r < BOARD_HEIGHT)
+    full += game->board.rows[r++] == ROW_FULL;
+  if (full != arg) {
+    fprintf(stderr, "benchmark: clear_lines_%d: %d full rows\n", arg, full);
+    exit(1);
+  }
+}
+
+// the midgame shape, resting on the stack, so the next fall locks it
+static void prepare_landed(Game *game, int arg) {
+  Shape *s;
+  *game = midgame;
+  s = &game->falling;
+  while (shape_collides(game->board.rows, s->type, s->angle, s->x, s->y + FALL_STEP) == 0)
+    s->y += FALL_STEP;
+}
+
+static void prepare_midgame(Game *game, int arg) {
+  *game = midgame;
+}
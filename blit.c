@@ -0,0 +1,165 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Drawing tiles, BLOCK_SIZE pixels square and stored row after row, into 32
+ * bits per pixel memory: a tile's row is a straight copy, so it goes with
+ * the widest vector loads and stores the CPU has rather than pixel by
+ * pixel.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#include <string.h>
+
+#include "blit.h"
+
+static void rows_scalar(uint32_t *to, int pitch, const uint32_t *from, int n);
+#ifdef HAVE_X86
+static void rows_avx2(uint32_t *to, int pitch, const uint32_t *from, int n);
+static void rows_sse2(uint32_t *to, int pitch, const uint32_t *from, int n);
+#endif
+
+// the row copy blit_tile() uses, the scalar one until blit_init() picks
+static void (*rows)(uint32_t *to, int pitch, const uint32_t *from, int n) = rows_scalar;
+
+/*
+ * Draws every filled cell of the board that meets the frame, wall
+ * coordinates being the frame's: per row, the occupancy word tells which
+ * cells to draw, and the cell plane only which tile.
+ */
+void blit_board(const Frame *frame, const Board *board, const uint32_t tiles[7][TILE_PIXELS]) {
+  uint32_t columns, filled;
+  int x, y, y_max, x_max;
+  if (frame->x + frame->w <= 0 || frame->y + frame->h <= 0 || frame->x >= WALL_WIDTH || frame->y >= WALL_HEIGHT ||
+    frame->w <= 0 || frame->h <= 0)
+    return;
+  x = (frame->x < 0) ? 0 : frame->x / BLOCK_SIZE;
+  x_max = (frame->x + frame->w - 1) / BLOCK_SIZE;
+  if (x_max >= BOARD_WIDTH)
+    x_max = BOARD_WIDTH - 1;
+  // the frame's columns, as bits of a row word
+  columns = ((2u << x_max) - (1u << x)) << BOARD_WALL;
+  y = (frame->y < 0) ? 0 : frame->y / BLOCK_SIZE;
+  y_max = (frame->y + frame->h - 1) / BLOCK_SIZE;
+  if (y_max >= BOARD_HEIGHT)
+    y_max = BOARD_HEIGHT - 1;
+  while (y <= y_max) {
+    filled = board->rows[y] & columns;
+    while (filled != 0) {
+      x = __builtin_ctz(filled) - BOARD_WALL;
+      filled &= filled - 1;
+      blit_tile(frame, x * BLOCK_SIZE, y * BLOCK_SIZE, tiles[board_cell(board, x, y) - 1]);
+    }
+    ++y;
+  }
+}
+
+// picks the widest row copy the CPU has, once, rather than asking it every tile
+void blit_init() {
+#ifdef HAVE_X86
+  if (__builtin_cpu_supports("avx2"))
+    rows = rows_avx2;
+  else if (__builtin_cpu_supports("sse2"))
+    rows = rows_sse2;
+#endif
+}
+
+// draws a tile with its upper left corner at x, y, clipped to the frame
+void blit_tile(const Frame *frame, int x, int y, const uint32_t tile[TILE_PIXELS]) {
+  uint32_t *to;
+  int top, bottom, left, right, i;
+  top = (frame->y > y) ? frame->y - y : 0;
+  bottom = (frame->y + frame->h < y + BLOCK_SIZE) ? frame->y + frame->h - y : BLOCK_SIZE;
+  left = (frame->x > x) ? frame->x - x : 0;
+  right = (frame->x + frame->w < x + BLOCK_SIZE) ? frame->x + frame->w - x : BLOCK_SIZE;
+  if (top >= bottom || left >= right)
+    return;
+  to = frame->pixels + (y - frame->y + top) * frame->pitch + (x - frame->x);
+  tile += top * BLOCK_SIZE;
+  // cut on the side, it is copied a row at a time
+  if (left > 0 || right < BLOCK_SIZE) {
+    i = top;
+    while (i++ < bottom) {
+      memcpy(to + left, tile + left, (right - left) * sizeof(uint32_t));
+      to += frame->pitch;
+      tile += BLOCK_SIZE;
+    }
+    return;
+  }
+  rows(to, frame->pitch, tile, bottom - top);
+}
+
+// n whole rows of a tile
+static void rows_scalar(uint32_t *to, int pitch, const uint32_t *from, int n) {
+  while (n-- > 0) {
+    memcpy(to, from, BLOCK_SIZE * sizeof(uint32_t));
+    to += pitch;
+    from += BLOCK_SIZE;
+  }
+}
+
+#ifdef HAVE_X86
+// 8 pixels a store, then 4, then what is left
+__attribute__((target("avx2")))
+static void rows_avx2(uint32_t *to, int pitch, const uint32_t *from, int n) {
+  int i;
+  while (n-- > 0) {
+    i = 0;
+    while (i + 8 <= BLOCK_SIZE) {
+      _mm256_storeu_si256((__m256i *) (to + i), _mm256_loadu_si256((const __m256i *) (from + i)));
+      i += 8;
+    }
+    while (i + 4 <= BLOCK_SIZE) {
+      _mm_storeu_si128((__m128i *) (to + i), _mm_loadu_si128((const __m128i *) (from + i)));
+      i += 4;
+    }
+    while (i < BLOCK_SIZE) {
+      to[i] = from[i];
+      ++i;
+    }
+    to += pitch;
+    from += BLOCK_SIZE;
+  }
+}
+
+__attribute__((target("sse2")))
+static void rows_sse2(uint32_t *to, int pitch, const uint32_t *from, int n) {
+  int i;
+  while (n-- > 0) {
+    i = 0;
+    while (i + 4 <= BLOCK_SIZE) {
+      _mm_storeu_si128((__m128i *) (to + i), _mm_loadu_si128((const __m128i *) (from + i)));
+      i += 4;
+    }
+    while (i < BLOCK_SIZE) {
+      to[i] = from[i];
+      ++i;
+    }
+    to += pitch;
+    from += BLOCK_SIZE;
+  }
+}
+#endif
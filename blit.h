@@ -0,0 +1,47 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+#define TILE_PIXELS (BLOCK_SIZE * BLOCK_SIZE)
+
+/*
+ * A rectangle of 32 bits per pixel memory to draw into, and what clips the
+ * drawing: pixels is its upper left corner, which is at x, y in the
+ * coordinates drawing uses, and pitch is in pixels.
+ */
+typedef struct Frame {
+  uint32_t *pixels;
+  int pitch;
+  int x, y, w, h;
+} Frame;
+
+void blit_board(const Frame *frame, const Board *board, const uint32_t tiles[7][TILE_PIXELS]);
+void blit_init();
+void blit_tile(const Frame *frame, int x, int y, const uint32_t tile[TILE_PIXELS]);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bundle.h"
+
+void bundle_close(Bundle *bundle) {
+  munmap((void *) bundle->data, bundle->size);
+}
+
+// an image's pixels, in the mapped file, and its size; NULL when it is not there
+const uint32_t *bundle_find(const Bundle *bundle, const char *name, int *w, int *h) {
+  const BundleEntry *entry;
+  int i = 0;
+  while (i < bundle->count) {
+    entry = &bundle->entries[i++];
+    if (strncmp(entry->name, name, BUNDLE_NAME) == 0) {
+      *w = entry->w;
+      *h = entry->h;
+      return (const uint32_t *) (bundle->data + entry->offset);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Maps a bundle read only and checks that every image lies inside it.
+ * Returns 0, or -1 with the reason on stderr.
+ */
+int bundle_open(Bundle *bundle, const char *path) {
+  const BundleHeader *header;
+  const BundleEntry *entry;
+  struct stat st;
+  int fd, i;
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(BundleHeader)) {
+    fprintf(stderr, "%s: not a bundle\n", path);
+    close(fd);
+    return -1;
+  }
+  bundle->size = st.st_size;
+  bundle->data = mmap(NULL, bundle->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (bundle->data == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+  header = (const BundleHeader *) bundle->data;
+  bundle->entries = (const BundleEntry *) (header + 1);
+  bundle->count = header->count;
+  if (memcmp(header->magic, "TPAK", 4) != 0 || header->version != BUNDLE_VERSION || header->order != BUNDLE_ORDER ||
+    header->count > (bundle->size - sizeof(BundleHeader)) / sizeof(BundleEntry)) {
+    fprintf(stderr, "%s: not a bundle of this version and byte order\n", path);
+    bundle_close(bundle);
+    return -1;
+  }
+  i = 0;
+  while (i < bundle->count) {
+    entry = &bundle->entries[i++];
+    if (entry->offset % 16 != 0 || entry->offset > bundle->size ||
+      (size_t) entry->w * entry->h * 4 > bundle->size - entry->offset) {
+      fprintf(stderr, "%s: image %.*s is cut short\n", path, BUNDLE_NAME, entry->name);
+      bundle_close(bundle);
+      return -1;
+    }
+  }
+  return 0;
+}
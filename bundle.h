@@ -0,0 +1,63 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUNDLE_VERSION 1
+// written in the packing machine's byte order, so a bundle from another one is refused
+#define BUNDLE_ORDER 0x01020304
+#define BUNDLE_NAME 20
+
+/*
+ * A bundle is every image decoded ahead of time into one file that is
+ * mapped into memory and used in place. It starts with this header, then
+ * count entries, then the pixels: 32 bits each, 0x00RRGGBB in the machine's
+ * byte order, row after row with no padding, every image at an offset that
+ * is a multiple of 16.
+ */
+typedef struct BundleHeader {
+  char magic[4]; // "TPAK"
+  uint32_t version, order, count;
+} BundleHeader;
+
+typedef struct BundleEntry {
+  char name[BUNDLE_NAME]; // the image's file name, NUL padded
+  uint16_t w, h;
+  uint32_t offset, reserved;
+} BundleEntry;
+
+typedef struct Bundle {
+  const uint8_t *data;
+  size_t size;
+  const BundleEntry *entries;
+  int count;
+} Bundle;
+
+void bundle_close(Bundle *bundle);
+const uint32_t *bundle_find(const Bundle *bundle, const char *name, int *w, int *h);
+int bundle_open(Bundle *bundle, const char *path);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <png.h>
+
+#include "capture.h"
+
+static int pattern_valid(const char *pattern);
+static void *write_frames(void *arg);
+static int write_frame(Capture *capture, const uint32_t *frame, uint8_t *rgb, long n);
+
+// writes the frames still in the ring, and stops the writer
+void capture_close(Capture *capture) {
+  pthread_mutex_lock(&capture->lock);
+  capture->closing = 1;
+  pthread_cond_signal(&capture->ready);
+  pthread_mutex_unlock(&capture->lock);
+  pthread_join(capture->thread, NULL);
+  if (capture->pipe != NULL && pclose(capture->pipe) != 0 && capture->error == 0)
+    capture->error = 1;
+  pthread_mutex_destroy(&capture->lock);
+  pthread_cond_destroy(&capture->ready);
+  pthread_cond_destroy(&capture->room);
+  free(capture->slots);
+}
+
+int capture_open(Capture *capture, const char *target, int w, int h, int rshift, int gshift, int bshift) {
+  memset(capture, 0, sizeof(Capture));
+  capture->w = w;
+  capture->h = h;
+  capture->rshift = rshift;
+  capture->gshift = gshift;
+  capture->bshift = bshift;
+  if (target[0] == '|') {
+    // an encoder that quits makes writes fail rather than kill the game
+    signal(SIGPIPE, SIG_IGN);
+    if ((capture->pipe = popen(target + 1, "w")) == NULL) {
+      perror(target + 1);
+      return -1;
+    }
+  }
+  else if (pattern_valid(target))
+    capture->pattern = target;
+  else {
+    fprintf(stderr, "%s: not a file name pattern with one %%d, or a |command\n", target);
+    return -1;
+  }
+  if ((capture->slots = malloc((size_t) CAPTURE_SLOTS * w * h * sizeof(uint32_t))) == NULL) {
+    if (capture->pipe != NULL)
+      pclose(capture->pipe);
+    return -1;
+  }
+  pthread_mutex_init(&capture->lock, NULL);
+  pthread_cond_init(&capture->ready, NULL);
+  pthread_cond_init(&capture->room, NULL);
+  if (pthread_create(&capture->thread, NULL, write_frames, capture) != 0) {
+    fprintf(stderr, "capture: could not start the writer\n");
+    if (capture->pipe != NULL)
+      pclose(capture->pipe);
+    free(capture->slots);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Queues a frame, pitch in pixels. With the ring full, it waits for the
+ * writer if wait is set, and otherwise drops the frame and returns -1, so
+ * a live game is never held up by the disk.
+ */
+int capture_push(Capture *capture, const uint32_t *pixels, int pitch, int wait) {
+  uint32_t *slot;
+  int y;
+  pthread_mutex_lock(&capture->lock);
+  while (capture->count == CAPTURE_SLOTS && wait != 0)
+    pthread_cond_wait(&capture->room, &capture->lock);
+  if (capture->count == CAPTURE_SLOTS) {
+    ++capture->dropped;
+    pthread_mutex_unlock(&capture->lock);
+    return -1;
+  }
+  slot = capture->slots + (long) (capture->head + capture->count) % CAPTURE_SLOTS * capture->w * capture->h;
+  pthread_mutex_unlock(&capture->lock);
+  // the slot is this side's until it is counted in
+  y = 0;
+  while (y < capture->h) {
+    memcpy(slot + y * capture->w, pixels + y * pitch, capture->w * sizeof(uint32_t));
+    ++y;
+  }
+  pthread_mutex_lock(&capture->lock);
+  ++capture->count;
+  pthread_cond_signal(&capture->ready);
+  pthread_mutex_unlock(&capture->lock);
+  return 0;
+}
+
+// frame number n, as RGB bytes, to the pipe or to its own PNG file
+static int write_frame(Capture *capture, const uint32_t *frame, uint8_t *rgb, long n) {
+  png_image image;
+  char path[4096];
+  long i, size;
+  size = (long) capture->w * capture->h;
+  i = 0;
+  while (i < size) {
+    rgb[3 * i] = frame[i] >> capture->rshift;
+    rgb[3 * i + 1] = frame[i] >> capture->gshift;
+    rgb[3 * i + 2] = frame[i] >> capture->bshift;
+    ++i;
+  }
+  if (capture->pipe != NULL)
+    return (fwrite(rgb, 3, size, capture->pipe) == (size_t) size) ? 0 : -1;
+  snprintf(path, sizeof(path), capture->pattern, (int) n);
+  memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  image.width = capture->w;
+  image.height = capture->h;
+  image.format = PNG_FORMAT_RGB;
+#ifdef PNG_IMAGE_FLAG_FAST
+  // the frames are big and many; size matters less than keeping up
+  image.flags = PNG_IMAGE_FLAG_FAST;
+#endif
+  if (png_image_write_to_file(&image, path, 0, rgb, 3 * capture->w, NULL) == 0) {
+    fprintf(stderr, "%s: %s\n", path, image.message);
+    return -1;
+  }
+  return 0;
+}
+
+// whether pattern has exactly one conversion, an int one such as %06d, and %% for a '%'
+static int pattern_valid(const char *pattern) {
+  int conversions = 0;
+  while ((pattern = strchr(pattern, '%')) != NULL) {
+    ++pattern;
+    if (*pattern == '%') {
+      ++pattern;
+      continue;
+    }
+    pattern += strspn(pattern, "-+ #0");
+    pattern += strspn(pattern, "0123456789");
+    if (*pattern != 'd' && *pattern != 'i')
+      return 0;
+    ++pattern;
+    ++conversions;
+  }
+  return conversions == 1;
+}
+
+// the writer thread: takes frames from the ring until it is closed and empty
+static void *write_frames(void *arg) {
+  Capture *capture = arg;
+  uint32_t *slot;
+  uint8_t *rgb;
+  rgb = malloc((size_t) 3 * capture->w * capture->h);
+  pthread_mutex_lock(&capture->lock);
+  while (1) {
+    while (capture->count == 0 && capture->closing == 0)
+      pthread_cond_wait(&capture->ready, &capture->lock);
+    if (capture->count == 0)
+      break;
+    slot = capture->slots + (long) capture->head * capture->w * capture->h;
+    pthread_mutex_unlock(&capture->lock);
+    // after an error the frames are only taken off, so the drawing side never waits for good
+    if (rgb == NULL || (capture->error == 0 && write_frame(capture, slot, rgb, capture->written) != 0))
+      capture->error = 1;
+    else if (capture->error == 0)
+      ++capture->written;
+    pthread_mutex_lock(&capture->lock);
+    capture->head = (capture->head + 1) % CAPTURE_SLOTS;
+    --capture->count;
+    pthread_cond_signal(&capture->room);
+  }
+  pthread_mutex_unlock(&capture->lock);
+  free(rgb);
+  return NULL;
+}
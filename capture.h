@@ -0,0 +1,62 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// frames the ring holds between the drawing and the writer
+#define CAPTURE_SLOTS 8
+
+/*
+ * Frames on their way to disk. capture_push() copies a frame into a free
+ * slot of the ring, and a writer thread takes them from there in order and
+ * writes each as a PNG file, when the target is a printf() pattern such as
+ * "frames/%06d.png", or as raw RGB bytes down a pipe to a command, when the
+ * target starts with '|'. Only the writer touches files.
+ */
+typedef struct Capture {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t ready, room;
+  // XRGB pixels, w * h per slot; count slots from head on are waiting
+  uint32_t *slots;
+  int head, count;
+  int w, h;
+  // where each channel is in a pixel
+  int rshift, gshift, bshift;
+  const char *pattern;
+  FILE *pipe;
+  int closing;
+  // frames written, dropped for want of room, and the first error
+  long written, dropped;
+  int error;
+} Capture;
+
+void capture_close(Capture *capture);
+int capture_open(Capture *capture, const char *target, int w, int h, int rshift, int gshift, int bshift);
+int capture_push(Capture *capture, const uint32_t *pixels, int pitch, int wait);
+
+#endif
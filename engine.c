@@ -0,0 +1,514 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+ 
+#include <string.h>
+
+#include "engine.h"
+
+static uint32_t rng_next(Game *game);
+static void shape_lock(Game *game);
+
+// games are forked by copying them, so Game has to stay small
+_Static_assert(sizeof(Game) <= 512, "Game should fit in 512 bytes");
+
+/*
+ * Gravity, in hundredths of a cell per second, for levels 1 and up; the last
+ * entry holds for every higher level.
+ */
+static const int gravity_table[] = {
+  500, 600, 700, 850, 1000, 1200, 1500, 2000, 2500, 3000
+};
+
+/*
+ * Every shape in its 4 orientations, as one bit mask per row of its box (bit
+ * c for column c), and as the box column and row of each of its 4 squares.
+ * Orientation a + 1 is orientation a turned clockwise around the middle of
+ * the box.
+ */
+static const uint8_t shape_masks[7][4][4] = {
+  { // g.jpg
+    { 0x6, 0x2, 0x2, 0x0 },
+    { 0x0, 0x7, 0x4, 0x0 },
+    { 0x2, 0x2, 0x3, 0x0 },
+    { 0x1, 0x7, 0x0, 0x0 },
+  },
+  { // i.jpg
+    { 0x2, 0x2, 0x2, 0x2 },
+    { 0x0, 0xf, 0x0, 0x0 },
+    { 0x4, 0x4, 0x4, 0x4 },
+    { 0x0, 0x0, 0xf, 0x0 },
+  },
+  { // l.jpg
+    { 0x2, 0x2, 0x6, 0x0 },
+    { 0x0, 0x7, 0x1, 0x0 },
+    { 0x3, 0x2, 0x2, 0x0 },
+    { 0x4, 0x7, 0x0, 0x0 },
+  },
+  { // o.jpg
+    { 0x3, 0x3, 0x0, 0x0 },
+    { 0x3, 0x3, 0x0, 0x0 },
+    { 0x3, 0x3, 0x0, 0x0 },
+    { 0x3, 0x3, 0x0, 0x0 },
+  },
+  { // s.jpg
+    { 0x6, 0x3, 0x0, 0x0 },
+    { 0x2, 0x6, 0x4, 0x0 },
+    { 0x0, 0x6, 0x3, 0x0 },
+    { 0x1, 0x3, 0x2, 0x0 },
+  },
+  { // t.jpg
+    { 0x7, 0x2, 0x0, 0x0 },
+    { 0x4, 0x6, 0x4, 0x0 },
+    { 0x0, 0x2, 0x7, 0x0 },
+    { 0x1, 0x3, 0x1, 0x0 },
+  },
+  { // z.jpg
+    { 0x3, 0x6, 0x0, 0x0 },
+    { 0x4, 0x6, 0x2, 0x0 },
+    { 0x0, 0x3, 0x6, 0x0 },
+    { 0x2, 0x3, 0x1, 0x0 },
+  },
+};
+
+static const Cell shape_squares[7][4][4] = {
+  { // g.jpg
+    { { 1, 0 }, { 2, 0 }, { 1, 1 }, { 1, 2 } },
+    { { 0, 1 }, { 1, 1 }, { 2, 1 }, { 2, 2 } },
+    { { 1, 0 }, { 1, 1 }, { 0, 2 }, { 1, 2 } },
+    { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 } },
+  },
+  { // i.jpg
+    { { 1, 0 }, { 1, 1 }, { 1, 2 }, { 1, 3 } },
+    { { 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 } },
+    { { 2, 0 }, { 2, 1 }, { 2, 2 }, { 2, 3 } },
+    { { 0, 2 }, { 1, 2 }, { 2, 2 }, { 3, 2 } },
+  },
+  { // l.jpg
+    { { 1, 0 }, { 1, 1 }, { 1, 2 }, { 2, 2 } },
+    { { 0, 1 }, { 1, 1 }, { 2, 1 }, { 0, 2 } },
+    { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 1, 2 } },
+    { { 2, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 } },
+  },
+  { // o.jpg
+    { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } },
+    { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } },
+    { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } },
+    { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } },
+  },
+  { // s.jpg
+    { { 1, 0 }, { 2, 0 }, { 0, 1 }, { 1, 1 } },
+    { { 1, 0 }, { 1, 1 }, { 2, 1 }, { 2, 2 } },
+    { { 1, 1 }, { 2, 1 }, { 0, 2 }, { 1, 2 } },
+    { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 2 } },
+  },
+  { // t.jpg
+    { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 1, 1 } },
+    { { 2, 0 }, { 1, 1 }, { 2, 1 }, { 2, 2 } },
+    { { 1, 1 }, { 0, 2 }, { 1, 2 }, { 2, 2 } },
+    { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 0, 2 } },
+  },
+  { // z.jpg
+    { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 2, 1 } },
+    { { 2, 0 }, { 1, 1 }, { 2, 1 }, { 1, 2 } },
+    { { 0, 1 }, { 1, 1 }, { 1, 2 }, { 2, 2 } },
+    { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 0, 2 } },
+  },
+};
+
+/*
+ * Offsets tried in turn when a rotation collides, in columns and rows: in
+ * place, one column either way, one row up, then two columns either way for
+ * the long bar only.
+ */
+static const Cell shape_kicks[7][6] = {
+  { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 } },
+  { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { -2, 0 }, { 2, 0 } },
+  { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 } },
+  { { 0, 0 } },
+  { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 } },
+  { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 } },
+  { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 } }
+};
+
+static const int shape_nkicks[7] = { 4, 6, 4, 1, 4, 4, 4 };
+
+// what fills a cell: a piece type plus one, or 0
+int board_cell(const Board *board, int x, int y) {
+  return (board->cells[y][x / 2] >> ((x & 1) * 4)) & 15;
+}
+
+void board_lock(Game *game, Shape *shape) {
+  Cell pos[4];
+  int i, x, y;
+  shape_cells(shape, pos);
+  i = 0;
+  while (i < 4) {
+    x = pos[i].x / BLOCK_SIZE;
+    y = pos[i].y / BLOCK_SIZE;
+    game->board.rows[y] |= 1u << (x + BOARD_WALL);
+    board_set(&game->board, x, y, shape->type + 1);
+    if (y < game->board.tops[x])
+      game->board.tops[x] = y;
+    ++i;
+  }
+}
+
+// changes what board_cell() says of a cell, not its occupancy bit
+void board_set(Board *board, int x, int y, int value) {
+  uint8_t *byte = &board->cells[y][x / 2];
+  *byte = (*byte & ~(15 << ((x & 1) * 4))) | (value << ((x & 1) * 4));
+}
+
+// works tops[] out again from the rows, going down from the top a word at a time
+void board_tops(Board *board) {
+  uint32_t left = ~ROW_EMPTY, found;
+  int r, x;
+  memset(board->tops, BOARD_HEIGHT, sizeof(board->tops));
+  r = 0;
+  while (left != 0 && r < BOARD_HEIGHT) {
+    found = board->rows[r] & left;
+    left &= ~found;
+    while (found != 0) {
+      x = __builtin_ctz(found) - BOARD_WALL;
+      board->tops[x] = r;
+      found &= found - 1;
+    }
+    ++r;
+  }
+}
+
+void check_lost(Game *game) {
+  if (game->board.rows[0] != ROW_EMPTY)
+    game->over = 1;
+}
+
+/*
+ * Clears the full rows among the 4 from top, where a shape just locked, and
+ * returns how many there were, their indices going into cleared[] from the
+ * top down. Rows move as a whole, so nothing is left floating.
+ */
+int clear_lines(Game *game, int top, int cleared[4]) {
+  Board *board = &game->board;
+  int bottom, n, r, w, x;
+  bottom = (top + 3 < BOARD_HEIGHT) ? top + 3 : BOARD_HEIGHT - 1;
+  n = 0;
+  r = top;
+  while (r <= bottom) {
+    if (board->rows[r] == ROW_FULL)
+      cleared[n++] = r;
+    ++r;
+  }
+  if (n == 0)
+    return 0;
+  // the few rows kept between full ones sink to the bottom of the window
+  w = bottom;
+  r = bottom;
+  while (r >= top) {
+    if (board->rows[r] != ROW_FULL) {
+      if (w != r) {
+        board->rows[w] = board->rows[r];
+        memcpy(board->cells[w], board->cells[r], sizeof(board->cells[0]));
+      }
+      --w;
+    }
+    --r;
+  }
+  // then everything above the window comes down n rows in one block
+  memmove(&board->rows[n], &board->rows[0], top * sizeof(board->rows[0]));
+  memmove(board->cells[n], board->cells[0], top * sizeof(board->cells[0]));
+  r = 0;
+  while (r < n)
+    board->rows[r++] = ROW_EMPTY;
+  memset(board->cells, 0, n * sizeof(board->cells[0]));
+  /*
+   * A full row has a cell in every column, so no column tops out below the
+   * first cleared one: those above it come down n rows, and those it topped
+   * are looked down for, from below where the rows above it went.
+   */
+  x = 0;
+  while (x < BOARD_WIDTH) {
+    if (board->tops[x] < cleared[0])
+      board->tops[x] += n;
+    else {
+      r = cleared[0] + n;
+      while (r < BOARD_HEIGHT && !(board->rows[r] & (1u << (x + BOARD_WALL))))
+        ++r;
+      board->tops[x] = r;
+    }
+    ++x;
+  }
+  return n;
+}
+
+void falling_next(Game *game) {
+  ++game->pieces;
+  shape_spawn(&game->falling, game->queue[0]);
+  memmove(&game->queue[0], &game->queue[1], (QUEUE_SIZE - 1) * sizeof(game->queue[0]));
+  game->queue[QUEUE_SIZE - 1] = shape_new(game);
+}
+
+void game_new(Game *game, uint64_t seed, int randomizer) {
+  int y;
+  // initializing the full grid as empty rows, standing on a solid floor
+  y = 0;
+  while (y < BOARD_HEIGHT + BOARD_FLOOR) {
+    game->board.rows[y] = (y < BOARD_HEIGHT) ? ROW_EMPTY : ROW_FULL;
+    ++y;
+  }
+  memset(game->board.cells, 0, sizeof(game->board.cells));
+  memset(game->board.tops, BOARD_HEIGHT, sizeof(game->board.tops));
+  game->level = 1;
+  game->lines = 0;
+  game->over = 0;
+  game->paused = 0;
+  game->drop = 0;
+  // the usual PCG32 seeding
+  game->rng = 0;
+  rng_next(game);
+  game->rng += seed;
+  rng_next(game);
+  game->randomizer = randomizer;
+  game->bag = 0;
+  game->pieces = 0;
+  y = 0;
+  while (y < QUEUE_SIZE)
+    game->queue[y++] = shape_new(game);
+  falling_next(game);
+}
+
+/*
+ * Advances the game by one tick, 1/TICK_RATE of a second: the falling shape
+ * goes down by what gravity covers in a tick, then the inputs are applied in
+ * the order left, right, clockwise, counter clockwise, drop.
+ */
+void game_step(Game *game, int input) {
+  if (game->paused == 0 && game->over == 0) {
+    game->drop += gravity(game->level);
+    while (game->drop >= SUBPIXELS) {
+      game->drop -= SUBPIXELS;
+      if (shape_fall(game) == 1) { // a new shape starts from rest
+        game->drop = 0;
+        break;
+      }
+    }
+  }
+  check_lost(game);
+  if (game->over == 0 && (input & INPUT_PAUSE))
+    game->paused ^= 1;
+  if (game->paused == 1 || game->over == 1)
+    return;
+  if (input & INPUT_LEFT)
+    move_left(game);
+  if (input & INPUT_RIGHT)
+    move_right(game);
+  if (input & INPUT_CW)
+    shape_flip(game, 1);
+  if (input & INPUT_CCW)
+    shape_flip(game, 0);
+  if (input & INPUT_DROP) {
+    shape_drop(game);
+    game->drop = 0;
+  }
+}
+
+// how far the falling shape goes down in one tick, in pixels times SUBPIXELS
+int gravity(int level) {
+  int n = sizeof(gravity_table) / sizeof(gravity_table[0]);
+  int cells = gravity_table[(level > n) ? n - 1 : level - 1];
+  return cells * BLOCK_SIZE * SUBPIXELS / (100 * TICK_RATE);
+}
+
+void move_left(Game *game) {
+  Shape *s = &game->falling;
+  if (shape_collides(game->board.rows, s->type, s->angle, s->x - 1, s->y) == 0)
+    --s->x;
+}
+
+void move_right(Game *game) {
+  Shape *s = &game->falling;
+  if (shape_collides(game->board.rows, s->type, s->angle, s->x + 1, s->y) == 0)
+    ++s->x;
+}
+
+// the pixel position of each of the shape's squares
+void shape_cells(const Shape *shape, Cell pos[4]) {
+  const Cell *squares = shape_squares[shape->type][shape->angle];
+  int i = 0;
+  while (i < 4) {
+    pos[i].x = (shape->x + squares[i].x) * BLOCK_SIZE;
+    pos[i].y = shape->y + squares[i].y * BLOCK_SIZE;
+    ++i;
+  }
+}
+
+// the row masks of a shape's box, bit c for column c of the box
+const uint8_t *shape_mask(int type, int angle) {
+  return shape_masks[type][angle];
+}
+
+/*
+ * Tests a shape against the board's rows with one AND per row of its box. A shape
+ * between two rows, while falling, is tested against both.
+ */
+int shape_collides(const uint32_t rows[], int type, int angle, int x, int y) {
+  const uint8_t *mask = shape_masks[type][angle];
+  uint32_t row;
+  int i, top;
+  i = 0;
+  while (i < 4) {
+    if (mask[i] != 0) {
+      top = y + i * BLOCK_SIZE;
+      if (top < 0)
+        return 1;
+      row = rows[top / BLOCK_SIZE] | rows[(top + BLOCK_SIZE - 1) / BLOCK_SIZE];
+      if (((uint32_t) mask[i] << (x + BOARD_WALL)) & row)
+        return 1;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+// returns 1 when the shape could not fall and got locked in place
+int shape_fall(Game *game) {
+  Shape *s = &game->falling;
+  if (shape_collides(game->board.rows, s->type, s->angle, s->x, s->y + FALL_STEP) == 0) {
+    s->y += FALL_STEP;
+    return 0;
+  }
+  // stuck, let's fall a new shape
+  shape_lock(game);
+  return 1;
+}
+
+/*
+ * Where the falling shape comes to rest if it keeps falling, in pixels, from
+ * the tops of the box's columns: the bottom square of each column lands on
+ * that column's top. A shape hanging under a cell of one of its columns,
+ * tucked under an overhang, is let down row by row instead.
+ */
+int shape_landing(const Game *game) {
+  const Shape *s = &game->falling;
+  const uint8_t *mask = shape_masks[s->type][s->angle];
+  int bottom, c, i, land, r, top;
+  land = BOARD_HEIGHT;
+  c = 0;
+  while (c < 4) {
+    bottom = -1;
+    i = 0;
+    while (i < 4) {
+      if (mask[i] & (1 << c))
+        bottom = i;
+      ++i;
+    }
+    if (bottom >= 0) {
+      top = game->board.tops[s->x + c];
+      if (s->y + (bottom + 1) * BLOCK_SIZE > top * BLOCK_SIZE)
+        break;
+      if (top - 1 - bottom < land)
+        land = top - 1 - bottom;
+    }
+    ++c;
+  }
+  if (c == 4)
+    return land * BLOCK_SIZE;
+  // nothing stops a shape between two rows, so it reaches the next one
+  r = (s->y + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  while (shape_collides(game->board.rows, s->type, s->angle, s->x, (r + 1) * BLOCK_SIZE) == 0)
+    ++r;
+  return r * BLOCK_SIZE;
+}
+
+// hard drops the falling shape: straight down to where it lands, and locked there
+void shape_drop(Game *game) {
+  game->falling.y = shape_landing(game);
+  shape_lock(game);
+}
+
+// draws the type of a new shape from the game's randomizer
+int shape_new(Game *game) {
+  int k, type;
+  if (game->randomizer == RANDOM_UNIFORM)
+    return ((uint64_t) rng_next(game) * 7) >> 32;
+  if (game->bag == 0)
+    game->bag = 0x7f;
+  // pick the k-th type still in the bag
+  k = ((uint64_t) rng_next(game) * __builtin_popcount(game->bag)) >> 32;
+  type = 0;
+  while (!(game->bag & (1 << type)) || k-- > 0)
+    ++type;
+  game->bag &= ~(1 << type);
+  return type;
+}
+
+// puts a shape of the given type where shapes spawn
+void shape_spawn(Shape *shape, int type) {
+  shape->type = type;
+  shape->angle = 0;
+  // the first square of every shape spawns in the middle column, on the top row
+  shape->x = BOARD_WIDTH / 2 - shape_squares[type][0][0].x;
+  shape->y = 0;
+}
+
+/*
+ * Turns the falling shape a quarter, trying each of its kick offsets until
+ * one fits; the shape stays as it is when none does.
+ */
+void shape_flip(Game *game, int clockwise) {
+  Shape *s = &game->falling;
+  const Cell *kicks = shape_kicks[s->type];
+  int angle, i, x, y;
+  angle = (s->angle + ((clockwise == 0) ? 3 : 1)) & 3;
+  i = 0;
+  while (i < shape_nkicks[s->type]) {
+    x = s->x + kicks[i].x;
+    y = s->y + kicks[i].y * BLOCK_SIZE;
+    if (shape_collides(game->board.rows, s->type, angle, x, y) == 0) {
+      s->angle = angle;
+      s->x = x;
+      s->y = y;
+      return;
+    }
+    ++i;
+  }
+}
+
+// PCG32, O'Neill's XSH RR variant
+static uint32_t rng_next(Game *game) {
+  uint64_t old = game->rng;
+  uint32_t xorshifted, rot;
+  game->rng = old * 6364136223846793005ULL + 1442695040888963407ULL;
+  xorshifted = ((old >> 18) ^ old) >> 27;
+  rot = old >> 59;
+  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// locks the falling shape where it is, clears lines and spawns the next one
+static void shape_lock(Game *game) {
+  Shape *s = &game->falling;
+  int cleared[4], n;
+  board_lock(game, s);
+  n = clear_lines(game, s->y / BLOCK_SIZE + shape_squares[s->type][s->angle][0].y, cleared);
+  game->level += (game->lines + n) / 10 - game->lines / 10;
+  game->lines += n;
+  falling_next(game);
+}
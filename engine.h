@@ -0,0 +1,146 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+
+#define BLOCK_SIZE 20
+#define FALL_STEP 1
+#define WALL_WIDTH 400
+#define WALL_HEIGHT 600
+#define BOARD_WIDTH (WALL_WIDTH / BLOCK_SIZE)
+#define BOARD_HEIGHT (WALL_HEIGHT / BLOCK_SIZE)
+#define BOARD_FLOOR 5
+#define BOARD_WALL 6
+#define ROW_FULL 0xffffffff
+#define ROW_EMPTY (~(((1u << BOARD_WIDTH) - 1) << BOARD_WALL))
+#define TICK_RATE 120
+// Game::drop counts fractions of a pixel in these units
+#define SUBPIXELS 256
+// how many upcoming shapes the game knows in advance
+#define QUEUE_SIZE 5
+#define RANDOM_UNIFORM 0
+#define RANDOM_BAG 1
+
+// inputs given to game_step(), or-ed together
+#define INPUT_LEFT 1
+#define INPUT_RIGHT 2
+#define INPUT_CW 4
+#define INPUT_CCW 8
+#define INPUT_PAUSE 16
+#define INPUT_DROP 32
+
+/*
+ * The board keeps one occupancy word per cell row: bit BOARD_WALL + x is set
+ * when column x is filled, and every bit outside the well is set too, so the
+ * walls and the BOARD_FLOOR rows below the well collide like locked blocks.
+ * cells[][] only remembers which piece type (plus one) filled a cell, for
+ * drawing, in 4 bits: column x is in the low half of byte x / 2 when x is
+ * even, the high half when odd. Use board_cell() and board_set().
+ * tops[x] is the row of column x's highest filled cell, BOARD_HEIGHT when the
+ * column is empty; locks and clears keep it up to date, whoever writes rows[]
+ * directly calls board_tops() after.
+ */
+typedef struct Board {
+  uint32_t rows[BOARD_HEIGHT + BOARD_FLOOR];
+  uint8_t cells[BOARD_HEIGHT][BOARD_WIDTH / 2];
+  uint8_t tops[BOARD_WIDTH];
+} Board;
+
+// upper left corner of a square, from the upper left of the wall
+typedef struct Cell {
+  int x, y;
+} Cell;
+
+typedef struct Shape {
+  /*
+   * type 0 : g.jpg
+   * type 1 : i.jpg
+   * type 2 : l.jpg
+   * type 3 : o.jpg
+   * type 4 : s.jpg
+   * type 5 : t.jpg
+   * type 6 : z.jpg
+   */
+  int type;
+  // quarter turns clockwise from the way the shape spawns, 0 to 3
+  int angle;
+  /*
+   * upper left corner of the 4x4 box the shape turns in: x is a column, y is
+   * in pixels since shapes fall pixel by pixel
+   */
+  int x, y;
+} Shape;
+
+/*
+ * Everything a game is, in about 500 bytes and without a pointer: copying
+ * it, by assignment or memcpy(), forks the game, which the AI's search,
+ * snapshots and replays rely on.
+ */
+typedef struct Game {
+  Board board;
+  // the flags fill the board's last word, ahead of rng's alignment
+  uint8_t over;
+  uint8_t paused;
+  uint8_t randomizer;
+  uint8_t bag;
+  /*
+   * The shapes come from a PCG32 generator seeded by game_new(), so a seed
+   * replays the same game. RANDOM_BAG deals the 7 shapes in a random order
+   * before dealing them again; bag has a bit set for each type still to come.
+   */
+  uint64_t rng;
+  Shape falling;
+  int level;
+  int lines;
+  // shapes spawned so far, the falling one included
+  int pieces;
+  int drop;
+  // types of the upcoming shapes, queue[0] next
+  uint8_t queue[QUEUE_SIZE];
+} Game;
+
+int board_cell(const Board *board, int x, int y);
+void board_lock(Game *game, Shape *shape);
+void board_set(Board *board, int x, int y, int value);
+void board_tops(Board *board);
+void check_lost(Game *game);
+int clear_lines(Game *game, int top, int cleared[4]);
+void falling_next(Game *game);
+void game_new(Game *game, uint64_t seed, int randomizer);
+void game_step(Game *game, int input);
+int gravity(int level);
+void move_left(Game *game);
+void move_right(Game *game);
+void shape_cells(const Shape *shape, Cell pos[4]);
+int shape_collides(const uint32_t rows[], int type, int angle, int x, int y);
+const uint8_t *shape_mask(int type, int angle);
+void shape_drop(Game *game);
+int shape_fall(Game *game);
+void shape_flip(Game *game, int clockwise);
+int shape_landing(const Game *game);
+int shape_new(Game *game);
+void shape_spawn(Shape *shape, int type);
+
+#endif
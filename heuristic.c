@@ -0,0 +1,222 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Board features from the row words, a whole row at a time. Nothing here
+ * walks columns: per row,
+ *   - a hole is an empty well cell under the cells filled so far,
+ *   - the summed heights add up, row after row, the columns filled so far,
+ *   - bumpiness adds up the rows where exactly one of two neighbouring
+ *     columns is filled so far, which is |h(c) - h(c + 1)| in the end,
+ *   - transitions are the bits that differ from their right neighbour.
+ * So the same few ANDs, XORs and popcounts serve one board in a register or
+ * one board per lane of a vector.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#include "heuristic.h"
+
+#define WELL (~ROW_EMPTY)
+// bit c when c and c + 1 are both well columns
+#define PAIRS (WELL & (WELL >> 1))
+// bit c when c or c + 1 is a well column, so the walls' edges are in
+#define EDGES (WELL | (WELL >> 1))
+
+static int bits(uint32_t v);
+#ifdef HAVE_X86
+static void batch_avx2(const Boards *boards, Features *features);
+static void batch_sse2(const Boards *boards, Features *features);
+#endif
+
+// the features of one board, stored in lane i of features
+void board_features(const uint32_t rows[], Features *features, int i) {
+  uint32_t covered, row;
+  int r, height, holes, transitions, bumpiness;
+  covered = 0;
+  height = 0;
+  holes = 0;
+  bumpiness = 0;
+  // rows over the surface only have their two edges with the walls
+  r = 0;
+  while (r < BOARD_HEIGHT && rows[r] == ROW_EMPTY)
+    ++r;
+  transitions = 2 * r;
+  while (r < BOARD_HEIGHT) {
+    row = rows[r];
+    transitions += bits((row ^ (row >> 1)) & EDGES);
+    holes += bits(~row & covered);
+    covered |= row & WELL;
+    height += bits(covered);
+    bumpiness += bits((covered ^ (covered >> 1)) & PAIRS);
+    ++r;
+  }
+  features->height[i] = height;
+  features->holes[i] = holes;
+  features->transitions[i] = transitions;
+  features->bumpiness[i] = bumpiness;
+}
+
+// the features of every board in the batch, with the widest vectors the CPU has
+void features_batch(const Boards *boards, Features *features) {
+#ifdef HAVE_X86
+  if (__builtin_cpu_supports("avx2")) {
+    batch_avx2(boards, features);
+    return;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    batch_sse2(boards, features);
+    return;
+  }
+#endif
+  features_scalar(boards, features);
+}
+
+// the same, one board at a time
+void features_scalar(const Boards *boards, Features *features) {
+  uint32_t rows[BOARD_HEIGHT];
+  int i, r;
+  i = 0;
+  while (i < boards->n) {
+    r = 0;
+    while (r < BOARD_HEIGHT) {
+      rows[r] = boards->rows[r][i];
+      ++r;
+    }
+    board_features(rows, features, i);
+    ++i;
+  }
+}
+
+// counts the set bits, without a libgcc call where there is no popcnt
+static int bits(uint32_t v) {
+  v = v - ((v >> 1) & 0x55555555);
+  v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+  return (((v + (v >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+#ifdef HAVE_X86
+/*
+ * The vector versions count bits per byte of each lane, as the first steps
+ * of bits() do, and add those byte counts up over all the rows: at most 8 a
+ * row, so 30 rows still fit in a byte (the rows over top count 2 each, in
+ * the lowest byte). The bytes are summed once, at the end.
+ */
+__attribute__((target("avx2")))
+static inline __m256i counts_avx2(__m256i v) {
+  v = _mm256_sub_epi32(v, _mm256_and_si256(_mm256_srli_epi32(v, 1), _mm256_set1_epi32(0x55555555)));
+  v = _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x33333333)),
+    _mm256_and_si256(_mm256_srli_epi32(v, 2), _mm256_set1_epi32(0x33333333)));
+  return _mm256_and_si256(_mm256_add_epi32(v, _mm256_srli_epi32(v, 4)), _mm256_set1_epi32(0x0f0f0f0f));
+}
+
+__attribute__((target("avx2")))
+static inline void sum_avx2(__m256i v, int *out) {
+  v = _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x00ff00ff)),
+    _mm256_and_si256(_mm256_srli_epi32(v, 8), _mm256_set1_epi32(0x00ff00ff)));
+  v = _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xffff)), _mm256_srli_epi32(v, 16));
+  _mm256_storeu_si256((__m256i *) out, v);
+}
+
+// eight boards a step
+__attribute__((target("avx2")))
+static void batch_avx2(const Boards *boards, Features *features) {
+  const __m256i well = _mm256_set1_epi32(WELL), pairs = _mm256_set1_epi32(PAIRS), edges = _mm256_set1_epi32(EDGES);
+  __m256i covered, row, height, holes, transitions, bumpiness;
+  int i, r;
+  i = 0;
+  while (i < boards->n) {
+    covered = _mm256_setzero_si256();
+    height = covered;
+    holes = covered;
+    // rows over top each have their two edges with the walls
+    transitions = _mm256_set1_epi32(2 * boards->top);
+    bumpiness = covered;
+    r = boards->top;
+    while (r < BOARD_HEIGHT) {
+      row = _mm256_loadu_si256((const __m256i *) &boards->rows[r][i]);
+      transitions = _mm256_add_epi32(transitions,
+        counts_avx2(_mm256_and_si256(_mm256_xor_si256(row, _mm256_srli_epi32(row, 1)), edges)));
+      holes = _mm256_add_epi32(holes, counts_avx2(_mm256_andnot_si256(row, covered)));
+      covered = _mm256_or_si256(covered, _mm256_and_si256(row, well));
+      height = _mm256_add_epi32(height, counts_avx2(covered));
+      bumpiness = _mm256_add_epi32(bumpiness,
+        counts_avx2(_mm256_and_si256(_mm256_xor_si256(covered, _mm256_srli_epi32(covered, 1)), pairs)));
+      ++r;
+    }
+    sum_avx2(height, &features->height[i]);
+    sum_avx2(holes, &features->holes[i]);
+    sum_avx2(transitions, &features->transitions[i]);
+    sum_avx2(bumpiness, &features->bumpiness[i]);
+    i += 8;
+  }
+}
+
+__attribute__((target("sse2")))
+static inline __m128i counts_sse2(__m128i v) {
+  v = _mm_sub_epi32(v, _mm_and_si128(_mm_srli_epi32(v, 1), _mm_set1_epi32(0x55555555)));
+  v = _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0x33333333)), _mm_and_si128(_mm_srli_epi32(v, 2), _mm_set1_epi32(0x33333333)));
+  return _mm_and_si128(_mm_add_epi32(v, _mm_srli_epi32(v, 4)), _mm_set1_epi32(0x0f0f0f0f));
+}
+
+__attribute__((target("sse2")))
+static inline void sum_sse2(__m128i v, int *out) {
+  v = _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0x00ff00ff)), _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0x00ff00ff)));
+  v = _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xffff)), _mm_srli_epi32(v, 16));
+  _mm_storeu_si128((__m128i *) out, v);
+}
+
+// four boards a step
+__attribute__((target("sse2")))
+static void batch_sse2(const Boards *boards, Features *features) {
+  const __m128i well = _mm_set1_epi32(WELL), pairs = _mm_set1_epi32(PAIRS), edges = _mm_set1_epi32(EDGES);
+  __m128i covered, row, height, holes, transitions, bumpiness;
+  int i, r;
+  i = 0;
+  while (i < boards->n) {
+    covered = _mm_setzero_si128();
+    height = covered;
+    holes = covered;
+    // rows over top each have their two edges with the walls
+    transitions = _mm_set1_epi32(2 * boards->top);
+    bumpiness = covered;
+    r = boards->top;
+    while (r < BOARD_HEIGHT) {
+      row = _mm_loadu_si128((const __m128i *) &boards->rows[r][i]);
+      transitions = _mm_add_epi32(transitions, counts_sse2(_mm_and_si128(_mm_xor_si128(row, _mm_srli_epi32(row, 1)), edges)));
+      holes = _mm_add_epi32(holes, counts_sse2(_mm_andnot_si128(row, covered)));
+      covered = _mm_or_si128(covered, _mm_and_si128(row, well));
+      height = _mm_add_epi32(height, counts_sse2(covered));
+      bumpiness = _mm_add_epi32(bumpiness, counts_sse2(_mm_and_si128(_mm_xor_si128(covered, _mm_srli_epi32(covered, 1)), pairs)));
+      ++r;
+    }
+    sum_sse2(height, &features->height[i]);
+    sum_sse2(holes, &features->holes[i]);
+    sum_sse2(transitions, &features->transitions[i]);
+    sum_sse2(bumpiness, &features->bumpiness[i]);
+    i += 4;
+  }
+}
+#endif
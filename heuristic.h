@@ -0,0 +1,58 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEURISTIC_H
+#define HEURISTIC_H
+
+#include "engine.h"
+
+// the most boards features_batch() takes in one call
+#define BATCH_MAX 32
+
+/*
+ * Boards laid out for SIMD, structure of arrays: rows[r][i] is row r of
+ * board i, walls included as on Board. Only the first n boards count, and
+ * their rows above top must all be empty; rows above top are not read.
+ */
+typedef struct Boards {
+  int n, top;
+  uint32_t rows[BOARD_HEIGHT][BATCH_MAX];
+} Boards;
+
+/*
+ * What the AI scores a board on, per board: the summed column heights, the
+ * empty cells under a filled one, the filled/empty changes along each row
+ * (the walls count as filled) and the height differences between
+ * neighbouring columns.
+ */
+typedef struct Features {
+  int height[BATCH_MAX];
+  int holes[BATCH_MAX];
+  int transitions[BATCH_MAX];
+  int bumpiness[BATCH_MAX];
+} Features;
+
+void board_features(const uint32_t rows[], Features *features, int i);
+void features_batch(const Boards *boards, Features *features);
+void features_scalar(const Boards *boards, Features *features);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "histogram.h"
+
+static int bucket(uint64_t value);
+static uint64_t bucket_low(int i);
+
+void histogram_add(Histogram *histogram, uint64_t value) {
+  ++histogram->counts[bucket(value)];
+  ++histogram->total;
+  if (value > histogram->max)
+    histogram->max = value;
+}
+
+void histogram_clear(Histogram *histogram) {
+  memset(histogram, 0, sizeof(Histogram));
+}
+
+// one line per non empty bucket: name, the bucket's bounds and its count
+void histogram_csv(FILE *file, const char *name, const Histogram *histogram) {
+  int i = 0;
+  while (i < HISTOGRAM_BUCKETS) {
+    if (histogram->counts[i] != 0)
+      fprintf(file, "%s,%llu,%llu,%lu\n", name, (unsigned long long) bucket_low(i),
+        (unsigned long long) bucket_low(i + 1) - 1, (unsigned long) histogram->counts[i]);
+    ++i;
+  }
+}
+
+// the value percentile % of the values are at most, as the top of its bucket
+uint64_t histogram_percentile(const Histogram *histogram, double percentile) {
+  uint64_t rank, seen, high;
+  int i;
+  if (histogram->total == 0)
+    return 0;
+  rank = histogram->total * percentile / 100;
+  if (rank < 1)
+    rank = 1;
+  seen = 0;
+  i = 0;
+  while (i < HISTOGRAM_BUCKETS - 1) {
+    seen += histogram->counts[i];
+    if (seen >= rank)
+      break;
+    ++i;
+  }
+  high = bucket_low(i + 1) - 1;
+  return (high < histogram->max) ? high : histogram->max;
+}
+
+/*
+ * Under 32 a value is its own bucket. Above, the bucket is set by the
+ * position of the top bit and the 4 bits under it.
+ */
+static int bucket(uint64_t value) {
+  int top;
+  if (value < (1u << HISTOGRAM_BITS))
+    return value;
+  top = 63 - __builtin_clzll(value);
+  if (top >= 40)
+    return HISTOGRAM_BUCKETS - 1;
+  return 32 + (top - HISTOGRAM_BITS) * 16 + ((value >> (top - 4)) & 15);
+}
+
+// the smallest value in bucket i
+static uint64_t bucket_low(int i) {
+  int top;
+  if (i < 32)
+    return i;
+  top = (i - 32) / 16 + HISTOGRAM_BITS;
+  return (uint64_t) (16 + (i - 32) % 16) << (top - 4);
+}
@@ -0,0 +1,49 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// values below 2^HISTOGRAM_BITS get a bucket each, larger ones 16 per power of two
+#define HISTOGRAM_BITS 5
+#define HISTOGRAM_BUCKETS (32 + (40 - HISTOGRAM_BITS) * 16)
+
+/*
+ * A latency histogram in the manner of HdrHistogram: buckets are exact for
+ * small values, then keep 4 significant bits, so any value is known within
+ * 1/16 whatever its size, from nanoseconds to minutes. Adding a value is a
+ * few instructions and never allocates.
+ */
+typedef struct Histogram {
+  uint32_t counts[HISTOGRAM_BUCKETS];
+  uint64_t total, max;
+} Histogram;
+
+void histogram_add(Histogram *histogram, uint64_t value);
+void histogram_clear(Histogram *histogram);
+void histogram_csv(FILE *file, const char *name, const Histogram *histogram);
+uint64_t histogram_percentile(const Histogram *histogram, double percentile);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "input.h"
+
+#define SHIFTS (INPUT_LEFT | INPUT_RIGHT)
+
+// das and arr in ticks
+void input_new(Input *input, int das, int arr) {
+  atomic_init(&input->head, 0);
+  atomic_init(&input->tail, 0);
+  input->das = das;
+  input->arr = arr;
+  input->held = 0;
+  input->shift = 0;
+  input->tick = 0;
+  input->shift_tick = 0;
+}
+
+// queues an event, in time order; returns -1, dropping it, when the queue is full
+int input_push(Input *input, uint64_t time, int key, int down) {
+  InputEvent *event;
+  unsigned tail = atomic_load_explicit(&input->tail, memory_order_relaxed);
+  if (tail - atomic_load_explicit(&input->head, memory_order_acquire) == INPUT_QUEUE)
+    return -1;
+  event = &input->events[tail % INPUT_QUEUE];
+  event->time = time;
+  event->key = key;
+  event->down = down;
+  atomic_store_explicit(&input->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+/*
+ * The input of the next tick, from the events that happened up to time.
+ * Of left and right, the last one pressed auto shifts; releasing it hands
+ * over to the other if that one is still held, with a fresh delay.
+ */
+int input_tick(Input *input, uint64_t time) {
+  InputEvent *event;
+  unsigned head, tail;
+  long held_for;
+  int bits = 0;
+  head = atomic_load_explicit(&input->head, memory_order_relaxed);
+  tail = atomic_load_explicit(&input->tail, memory_order_acquire);
+  while (head != tail && input->events[head % INPUT_QUEUE].time <= time) {
+    event = &input->events[head++ % INPUT_QUEUE];
+    if (event->down == 1) {
+      if ((input->held & event->key) == 0)
+        bits |= event->key;
+      input->held |= event->key;
+      if (event->key & SHIFTS) {
+        input->shift = event->key;
+        input->shift_tick = input->tick;
+      }
+    }
+    else {
+      input->held &= ~event->key;
+      if (event->key == input->shift) {
+        input->shift = input->held & SHIFTS;
+        input->shift_tick = input->tick;
+      }
+    }
+  }
+  atomic_store_explicit(&input->head, head, memory_order_release);
+  if (input->shift != 0 && (bits & input->shift) == 0) {
+    held_for = input->tick - input->shift_tick;
+    if (held_for >= input->das && (input->arr == 0 || (held_for - input->das) % input->arr == 0))
+      bits |= input->shift;
+  }
+  ++input->tick;
+  return bits;
+}
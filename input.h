@@ -0,0 +1,65 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// a power of two, so the counts below can wrap
+#define INPUT_QUEUE 64
+// the usual auto shift: a held shift repeats after DAS, then every ARR, in milliseconds
+#define DEFAULT_DAS 170
+#define DEFAULT_ARR 50
+
+// a key going down or up, as one of the INPUT_ bits, at a time in nanoseconds
+typedef struct InputEvent {
+  uint64_t time;
+  int key, down;
+} InputEvent;
+
+/*
+ * Turns key events into the input of each tick. Events wait in a queue
+ * until the tick that takes them; a press acts on that tick, whatever else
+ * is pressed with it, and a held left or right shifts again on its own
+ * after das ticks, then every arr ticks (every tick when arr is 0). All of
+ * this counts ticks, not frames.
+ * One thread may push while another ticks: events go in at tail and come out
+ * at head, and each side only moves its own end.
+ */
+typedef struct Input {
+  InputEvent events[INPUT_QUEUE];
+  atomic_uint head, tail;
+  int das, arr;
+  // keys down, the direction auto shifting and the tick it started from
+  int held, shift;
+  long tick, shift_tick;
+} Input;
+
+void input_new(Input *input, int das, int arr);
+int input_push(Input *input, uint64_t time, int key, int down);
+int input_tick(Input *input, uint64_t time);
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Plays many games on a session server at once, for measuring it: each
+ * client starts a game, sends random moves now and then, and keeps a copy
+ * of its board up to date from the states it receives. Every state carries
+ * the server's clock when its tick began, so on the same machine the time
+ * until it is handled here is the tick latency. The totals are printed as
+ * a line of JSON, like the benchmark program.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#include "histogram.h"
+#include "session.h"
+
+#define MAX_EVENTS 256
+// how often moves are sent, in ticks per second
+#define INPUT_RATE 60
+
+typedef struct Client {
+  Game mirror;
+  int fd;
+  uint64_t seed;
+  uint8_t in[2 * MSG_MAX];
+  int in_len;
+  uint32_t tick;
+} Client;
+
+// the totals and the current second's latencies
+typedef struct Load {
+  Client *clients;
+  int count;
+  Histogram latency, recent;
+  long states, bytes, games, errors;
+} Load;
+
+static void client_input(Load *load, Client *client, int input);
+static void client_new(Load *load, Client *client);
+static int client_read(Load *load, Client *client);
+static uint64_t now();
+static uint64_t xorshift(uint64_t *state);
+
+int main(int argc, char **argv) {
+  Load load;
+  Client *client;
+  struct sockaddr_un addr;
+  struct epoll_event event, events[MAX_EVENTS];
+  struct itimerspec interval;
+  struct rlimit limit;
+  const char *path;
+  const int moves[4] = { INPUT_LEFT, INPUT_RIGHT, INPUT_CW, INPUT_CCW };
+  uint64_t start, second, end, expirations, state;
+  double seconds;
+  int i, n, timer, epoll, inputs;
+  path = "tetris.sock";
+  load.count = 1000;
+  seconds = 10;
+  inputs = 4;
+  i = 1;
+  while (i < argc) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      path = argv[++i];
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      load.count = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+      inputs = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [-s socket] [-c clients] [-t seconds] [-i inputs per second]\n", argv[0]);
+      return 2;
+    }
+    ++i;
+  }
+  if (load.count <= 0 || strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: bad client count or socket path\n", argv[0]);
+    return 2;
+  }
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+  load.clients = calloc(load.count, sizeof(Client));
+  histogram_clear(&load.latency);
+  histogram_clear(&load.recent);
+  load.states = 0;
+  load.bytes = 0;
+  load.games = 0;
+  load.errors = 0;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  epoll = epoll_create1(0);
+  i = 0;
+  while (i < load.count) {
+    client = &load.clients[i];
+    // connecting blocks while the server's backlog is full, then the socket stops blocking
+    if ((client->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      connect(client->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+      perror(path);
+      return 1;
+    }
+    fcntl(client->fd, F_SETFL, O_NONBLOCK);
+    client->seed = i;
+    client_new(&load, client);
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, client->fd, &event);
+    ++i;
+  }
+  timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  interval.it_interval.tv_sec = 0;
+  interval.it_interval.tv_nsec = 1000000000 / INPUT_RATE;
+  interval.it_value = interval.it_interval;
+  timerfd_settime(timer, 0, &interval, NULL);
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
+  state = 88172645463325252ULL;
+  start = now();
+  second = start;
+  end = start + seconds * 1e9;
+  while (now() < end) {
+    n = epoll_wait(epoll, events, MAX_EVENTS, 100);
+    i = 0;
+    while (i < n) {
+      client = events[i++].data.ptr;
+      // each client moves inputs times a second, on average
+      if (client == NULL && read(timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+        client = load.clients;
+        while (client < load.clients + load.count) {
+          if (xorshift(&state) % INPUT_RATE < (uint64_t) inputs)
+            client_input(&load, client, moves[xorshift(&state) & 3]);
+          ++client;
+        }
+      }
+      else if (client != NULL && client_read(&load, client) != 0) {
+        fprintf(stderr, "%s: server closed the connection\n", path);
+        return 1;
+      }
+    }
+    if (now() - second >= 1000000000) {
+      fprintf(stderr, "%llu states, latency p50 %llu us, p99 %llu us, max %llu us\n",
+        (unsigned long long) load.recent.total, (unsigned long long) histogram_percentile(&load.recent, 50) / 1000,
+        (unsigned long long) histogram_percentile(&load.recent, 99) / 1000,
+        (unsigned long long) load.recent.max / 1000);
+      histogram_clear(&load.recent);
+      second = now();
+    }
+  }
+  seconds = (now() - start) / 1e9;
+  printf("{\"name\": \"server\", \"clients\": %d, \"states_per_s\": %.0f, \"bytes_per_s\": %.0f, \"games\": %ld, "
+    "\"latency_p50_us\": %.1f, \"latency_p99_us\": %.1f, \"latency_max_us\": %.1f, \"errors\": %ld}\n", load.count,
+    load.states / seconds, load.bytes / seconds, load.games, histogram_percentile(&load.latency, 50) / 1e3,
+    histogram_percentile(&load.latency, 99) / 1e3, load.latency.max / 1e3, load.errors);
+  return 0;
+}
+
+// a move for the next tick; dropped, and counted, when the socket is full
+static void client_input(Load *load, Client *client, int input) {
+  uint8_t msg[4] = { 2, 0, MSG_INPUT, input };
+  if (send(client->fd, msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg))
+    ++load->errors;
+}
+
+// starts a game with the client's seed
+static void client_new(Load *load, Client *client) {
+  uint8_t msg[12] = { 10, 0, MSG_NEW };
+  int i = 0;
+  while (i < 8) {
+    msg[3 + i] = client->seed >> (8 * i);
+    ++i;
+  }
+  msg[11] = RANDOM_BAG;
+  if (send(client->fd, msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg))
+    ++load->errors;
+  ++load->games;
+}
+
+/*
+ * Applies the states received so far and times them. A lost game starts
+ * over with a seed no other client plays. Returns -1 when the server is
+ * gone.
+ */
+static int client_read(Load *load, Client *client) {
+  uint32_t tick;
+  uint64_t stamp, t;
+  ssize_t n;
+  int size;
+  while ((n = recv(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len, 0)) > 0) {
+    t = now();
+    load->bytes += n;
+    client->in_len += n;
+    while (client->in_len >= 2 && client->in_len >= 2 + (size = client->in[0] | client->in[1] << 8)) {
+      if (session_apply(&client->mirror, client->in, 2 + size, &tick, &stamp) != 0 || tick <= client->tick)
+        ++load->errors;
+      else {
+        ++load->states;
+        histogram_add(&load->latency, t - stamp);
+        histogram_add(&load->recent, t - stamp);
+        client->tick = tick;
+      }
+      client->in_len -= 2 + size;
+      memmove(client->in, client->in + 2 + size, client->in_len);
+      if (client->mirror.over == 1) {
+        client->mirror.over = 0;
+        client->seed += load->count;
+        client_new(load, client);
+      }
+    }
+  }
+  return (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) ? -1 : 0;
+}
+
+static uint64_t now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static uint64_t xorshift(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
@@ -0,0 +1,146 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Packs images into a bundle (see bundle.h) that the game maps at startup
+ * instead of decoding every JPEG, as in: pack -o images.pak images/g.jpg ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jpeglib.h>
+
+#include "bundle.h"
+
+static uint32_t *decode(const char *path, int *w, int *h);
+
+int main(int argc, char **argv) {
+  BundleHeader header;
+  BundleEntry *entries;
+  uint32_t **pixels;
+  const char *out, *name;
+  FILE *file;
+  long offset;
+  int i, first, w, h;
+  out = "images.pak";
+  first = 1;
+  if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+    out = argv[2];
+    first = 3;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "usage: %s [-o bundle] image.jpg...\n", argv[0]);
+    return 2;
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "TPAK", 4);
+  header.version = BUNDLE_VERSION;
+  header.order = BUNDLE_ORDER;
+  header.count = argc - first;
+  entries = calloc(header.count, sizeof(BundleEntry));
+  pixels = calloc(header.count, sizeof(uint32_t *));
+  offset = sizeof(header) + header.count * sizeof(BundleEntry);
+  i = 0;
+  while (i < (int) header.count) {
+    name = strrchr(argv[first + i], '/');
+    name = (name == NULL) ? argv[first + i] : name + 1;
+    if (strlen(name) > BUNDLE_NAME) {
+      fprintf(stderr, "%s: name longer than %d\n", name, BUNDLE_NAME);
+      return 1;
+    }
+    if ((pixels[i] = decode(argv[first + i], &w, &h)) == NULL)
+      return 1;
+    strncpy(entries[i].name, name, BUNDLE_NAME);
+    entries[i].w = w;
+    entries[i].h = h;
+    offset = (offset + 15) & ~15L;
+    entries[i].offset = offset;
+    offset += (long) w * h * 4;
+    ++i;
+  }
+  if ((file = fopen(out, "wb")) == NULL) {
+    perror(out);
+    return 1;
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(entries, sizeof(BundleEntry), header.count, file);
+  offset = sizeof(header) + header.count * sizeof(BundleEntry);
+  i = 0;
+  while (i < (int) header.count) {
+    // zeros up to the image's offset
+    while (offset < (long) entries[i].offset) {
+      fputc(0, file);
+      ++offset;
+    }
+    fwrite(pixels[i], 4, (size_t) entries[i].w * entries[i].h, file);
+    offset += (long) entries[i].w * entries[i].h * 4;
+    free(pixels[i++]);
+  }
+  if (fclose(file) != 0) {
+    perror(out);
+    return 1;
+  }
+  fprintf(stderr, "%s: %u images, %ld bytes\n", out, header.count, offset);
+  free(entries);
+  free(pixels);
+  return 0;
+}
+
+// a JPEG's pixels as 0x00RRGGBB words; libjpeg reports errors and exits
+static uint32_t *decode(const char *path, int *w, int *h) {
+  struct jpeg_decompress_struct jpeg;
+  struct jpeg_error_mgr error;
+  JSAMPROW row;
+  uint32_t *pixels, *p;
+  unsigned x;
+  FILE *file;
+  if ((file = fopen(path, "rb")) == NULL) {
+    perror(path);
+    return NULL;
+  }
+  jpeg.err = jpeg_std_error(&error);
+  jpeg_create_decompress(&jpeg);
+  jpeg_stdio_src(&jpeg, file);
+  jpeg_read_header(&jpeg, TRUE);
+  jpeg.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&jpeg);
+  *w = jpeg.output_width;
+  *h = jpeg.output_height;
+  pixels = malloc((size_t) *w * *h * sizeof(uint32_t));
+  row = malloc((size_t) *w * 3);
+  p = pixels;
+  while (jpeg.output_scanline < jpeg.output_height) {
+    jpeg_read_scanlines(&jpeg, &row, 1);
+    x = 0;
+    while (x < jpeg.output_width) {
+      *p++ = (uint32_t) row[3 * x] << 16 | row[3 * x + 1] << 8 | row[3 * x + 2];
+      ++x;
+    }
+  }
+  jpeg_finish_decompress(&jpeg);
+  jpeg_destroy_decompress(&jpeg);
+  free(row);
+  fclose(file);
+  return pixels;
+}
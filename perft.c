@@ -0,0 +1,321 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Counts the placements reachable from a position, the way chess engines
+ * check their move generators with perft. The falling shape is moved left,
+ * right, turned either way and let down a pixel at a time by the engine's
+ * own move_left(), move_right(), shape_flip() and gravity rule, from every
+ * position it can reach, so tucks under overhangs and turns that kick it
+ * into a slot all count. Placements that fill the same cells are one. Each
+ * is locked by shape_fall() and the search goes on with the next shape,
+ * depth shapes deep; the count is of the placements at the last one.
+ *   perft [-d depth] [name...]           the reference positions, checked
+ *   perft -b rows -p shapes [-d depth]    a position of one's own
+ * rows are the bottom of the board, top down, BOARD_WIDTH characters each
+ * separated by '/', '#' for a filled cell; shapes are the types in the
+ * order they come, by the letters of their images: g, i, l, o, s, t, z.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+
+// the falling shape and the queue hold this many of the sequence
+#define MAX_DEPTH (1 + QUEUE_SIZE)
+// the reference counts go this deep, deeper than a run goes by default
+#define REFERENCE_DEPTH 3
+#define DEFAULT_DEPTH 2
+#define MAX_PLACEMENTS 2048
+// a box reaches 3 columns out of the well on the left, and 3 rows above it
+#define COLUMNS (BOARD_WIDTH + 3)
+#define LINES (WALL_HEIGHT + 3 * BLOCK_SIZE)
+// a stack 25 rows high, with a hole in each row
+#define STACK5 "###.################/#.##################/#################.##/" \
+  "########.###########/##############.#####/"
+#define STACK25 STACK5 STACK5 STACK5 STACK5 STACK5
+
+typedef struct Position {
+  const char *name;
+  const char *rows;
+  const char *shapes;
+  long counts[REFERENCE_DEPTH];
+} Position;
+
+static long long now();
+static long perft(const Game *game, int depth);
+static int placements(Game *game, Shape found[MAX_PLACEMENTS]);
+static int position_new(Game *game, const char *rows, const char *shapes);
+static int run(const char *name, const char *rows, const char *shapes, int depth, const long *counts);
+static int visit(int n, const Shape *s);
+
+// where the falling shape has been during one search, and where it is still to go from
+static uint8_t seen[4][COLUMNS][LINES];
+static Shape stack[4 * COLUMNS * LINES];
+// positions searched from, over a whole count
+static long states;
+
+static const char types[] = "gilostz";
+
+/*
+ * On the empty board, depth 1 can be worked out by hand: a shape 2 columns
+ * wide fits 19 ways and one 3 wide 18, so t, g and l, two ways each, have
+ * 74 placements, s, z and i 37 and o 19.
+ */
+static const Position positions[] = {
+  { "empty_t", "", "tgliosz", { 74, 5540, 419739 } },
+  { "empty_o", "", "oiszgtl", { 19, 703, 26229 } },
+  // under the upper bar, the shapes only get in from the left
+  { "tuck", "......######......../..........#####.....", "lzitos", { 75, 2878, 116661 } },
+  // the t only gets into the slot under the lone cell by turning in
+  { "tspin", "........#.........../########...#########/###################.", "tszlgi", { 75, 2874, 109549 } },
+  { "well", "#########.##########/#########.##########/#########.##########/#########.##########", "iltzso",
+    { 37, 2738, 205733 } },
+  // 4 rows left, where most second shapes end the game
+  { "tall", STACK25 "...................#", "ztiolg", { 37, 2235, 46337 } }
+};
+
+int main(int argc, char **argv) {
+  const char *rows, *shapes;
+  int depth, failed, first, i, j;
+  rows = NULL;
+  shapes = NULL;
+  depth = DEFAULT_DEPTH;
+  i = 1;
+  while (i + 1 < argc && argv[i][0] == '-') {
+    if (strcmp(argv[i], "-d") == 0)
+      depth = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-b") == 0)
+      rows = argv[i + 1];
+    else if (strcmp(argv[i], "-p") == 0)
+      shapes = argv[i + 1];
+    else
+      break;
+    i += 2;
+  }
+  if ((i < argc && argv[i][0] == '-') || (rows == NULL) != (shapes == NULL) || depth < 1 || depth > MAX_DEPTH) {
+    fprintf(stderr, "usage: %s [-d depth] [name...] | -b rows -p shapes [-d depth]\n", argv[0]);
+    return 2;
+  }
+  if (shapes != NULL)
+    return run("position", rows, shapes, depth, NULL);
+  failed = 0;
+  first = i;
+  i = 0;
+  while (i < (int) (sizeof(positions) / sizeof(positions[0]))) {
+    j = first;
+    while (j < argc && strcmp(argv[j], positions[i].name) != 0)
+      ++j;
+    if (first == argc || j < argc)
+      failed |= run(positions[i].name, positions[i].rows, positions[i].shapes, depth, positions[i].counts);
+    ++i;
+  }
+  return failed;
+}
+
+static long long now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (long long) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// the placements depth shapes deep, the falling one's first
+static long perft(const Game *game, int depth) {
+  Game child;
+  Shape found[MAX_PLACEMENTS];
+  long nodes;
+  int i, n;
+  child = *game;
+  n = placements(&child, found);
+  if (depth == 1)
+    return n;
+  nodes = 0;
+  i = 0;
+  while (i < n) {
+    child = *game;
+    child.falling = found[i++];
+    // resting, the shape locks on its next fall, and the next one spawns
+    shape_fall(&child);
+    check_lost(&child);
+    if (child.over == 0)
+      nodes += perft(&child, depth - 1);
+  }
+  return nodes;
+}
+
+/*
+ * Every distinct placement of the falling shape, as the shape resting where
+ * it locks. The search moves the game's falling shape around, and leaves it
+ * anywhere. A shape spawned over the stack has none.
+ */
+static int placements(Game *game, Shape found[MAX_PLACEMENTS]) {
+  static uint64_t keys[MAX_PLACEMENTS];
+  Shape *s = &game->falling;
+  Shape from;
+  Cell pos[4];
+  uint64_t key;
+  int i, n, top;
+  if (shape_collides(game->board.rows, s->type, s->angle, s->x, s->y) == 1)
+    return 0;
+  memset(seen, 0, sizeof(seen));
+  n = 0;
+  top = visit(0, s);
+  while (top > 0) {
+    from = stack[--top];
+    ++states;
+    *s = from;
+    move_left(game);
+    top = visit(top, s);
+    *s = from;
+    move_right(game);
+    top = visit(top, s);
+    *s = from;
+    shape_flip(game, 1);
+    top = visit(top, s);
+    *s = from;
+    shape_flip(game, 0);
+    top = visit(top, s);
+    *s = from;
+    // shape_fall()'s test, short of locking the shape
+    if (shape_collides(game->board.rows, s->type, s->angle, s->x, s->y + FALL_STEP) == 0) {
+      s->y += FALL_STEP;
+      top = visit(top, s);
+      continue;
+    }
+    // shape_cells() goes top down and left to right at any angle, so the cells make a key
+    shape_cells(s, pos);
+    key = 0;
+    i = 0;
+    while (i < 4) {
+      key = key << 10 | (pos[i].y / BLOCK_SIZE * BOARD_WIDTH + pos[i].x / BLOCK_SIZE);
+      ++i;
+    }
+    i = 0;
+    while (i < n && keys[i] != key)
+      ++i;
+    if (i < n)
+      continue;
+    if (n == MAX_PLACEMENTS) {
+      fprintf(stderr, "perft: more than %d placements\n", MAX_PLACEMENTS);
+      exit(1);
+    }
+    keys[n] = key;
+    found[n++] = from;
+  }
+  return n;
+}
+
+// a game on the given rows, dealing the given shapes; -1 if either does not parse
+static int position_new(Game *game, const char *rows, const char *shapes) {
+  const char *type;
+  int n, x, y;
+  game_new(game, 1, RANDOM_BAG);
+  n = (rows[0] == '\0') ? 0 : 1;
+  x = 0;
+  while (rows[x] != '\0')
+    n += (rows[x++] == '/');
+  if (n > BOARD_HEIGHT || (int) strlen(rows) != n * (BOARD_WIDTH + 1) - (n > 0)) {
+    fprintf(stderr, "perft: rows should be %d cells each, separated by '/', %d at most\n", BOARD_WIDTH, BOARD_HEIGHT);
+    return -1;
+  }
+  y = BOARD_HEIGHT - n;
+  while (y < BOARD_HEIGHT) {
+    x = 0;
+    while (x < BOARD_WIDTH) {
+      if (*rows == '#') {
+        game->board.rows[y] |= 1u << (x + BOARD_WALL);
+        board_set(&game->board, x, y, 1);
+      }
+      else if (*rows != '.') {
+        fprintf(stderr, "perft: '%c' is not a cell\n", *rows);
+        return -1;
+      }
+      ++rows;
+      ++x;
+    }
+    ++rows;
+    ++y;
+  }
+  board_tops(&game->board);
+  n = 0;
+  while (shapes[n] != '\0') {
+    if ((type = strchr(types, shapes[n])) == NULL) {
+      fprintf(stderr, "perft: '%c' is not a shape\n", shapes[n]);
+      return -1;
+    }
+    if (n == 0)
+      shape_spawn(&game->falling, type - types);
+    else if (n <= QUEUE_SIZE)
+      game->queue[n - 1] = type - types;
+    ++n;
+  }
+  return 0;
+}
+
+// counts to each depth in turn, and checks the counts known; 1 if one differs
+static int run(const char *name, const char *rows, const char *shapes, int depth, const long *counts) {
+  Game game;
+  long long start, ns;
+  long nodes;
+  int d, failed;
+  if (position_new(&game, rows, shapes) != 0)
+    return 1;
+  if ((int) strlen(shapes) < depth) {
+    fprintf(stderr, "perft: %s: %d shapes, too few for depth %d\n", name, (int) strlen(shapes), depth);
+    return 1;
+  }
+  failed = 0;
+  d = 1;
+  while (d <= depth) {
+    states = 0;
+    start = now();
+    nodes = perft(&game, d);
+    ns = now() - start;
+    printf("%s depth %d: %ld placements, %ld positions searched in %.3f s, %.0f placements/s, %.0f positions/s", name, d,
+      nodes, states, ns / 1e9, nodes * 1e9 / ns, states * 1e9 / ns);
+    if (counts != NULL && d <= REFERENCE_DEPTH) {
+      if (nodes == counts[d - 1])
+        printf(", OK");
+      else {
+        printf(", expected %ld, MISMATCH", counts[d - 1]);
+        failed = 1;
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+    ++d;
+  }
+  return failed;
+}
+
+// pushes a position the search has not been to yet
+static int visit(int n, const Shape *s) {
+  uint8_t *mark = &seen[s->angle][s->x + 3][s->y + 3 * BLOCK_SIZE];
+  if (*mark == 0) {
+    *mark = 1;
+    stack[n++] = *s;
+  }
+  return n;
+}
@@ -0,0 +1,88 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Plays a replay back without a display, as fast as possible, and checks
+ * that it ends on the recorded board and line count. The throughput, in
+ * ticks per second, doubles as a regression benchmark.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "replay.h"
+
+int play(const char *path, Game *game, Replay *replay);
+
+int main(int argc, char **argv) {
+  Game game;
+  Replay replay;
+  struct timespec start, end;
+  double seconds;
+  long ticks;
+  int i, repeat;
+  repeat = 1;
+  if (argc == 4 && strcmp(argv[1], "-n") == 0)
+    repeat = atoi(argv[2]);
+  if ((argc != 2 && (argc != 4 || strcmp(argv[1], "-n") != 0)) || repeat < 1) {
+    fprintf(stderr, "usage: %s [-n times] replay\n", argv[0]);
+    return 2;
+  }
+  ticks = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  i = 0;
+  while (i++ < repeat) {
+    if (play(argv[argc - 1], &game, &replay) != 0)
+      return 1;
+    ticks += replay.tick;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%ld ticks in %.3f s, %.0f ticks/s\n", ticks, seconds, ticks / seconds);
+  printf("lines %d (recorded %d), board %016llx (recorded %016llx)\n", game.lines, replay.lines,
+    (unsigned long long) board_hash(&game.board), (unsigned long long) replay.hash);
+  if (game.lines != replay.lines || board_hash(&game.board) != replay.hash) {
+    printf("MISMATCH\n");
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
+
+int play(const char *path, Game *game, Replay *replay) {
+  uint64_t seed;
+  int randomizer;
+  if (replay_open(replay, path, &seed, &randomizer) != 0)
+    return -1;
+  game_new(game, seed, randomizer);
+  while (replay_done(replay) == 0) {
+    if (replay->next < 0 && replay->end < 0) {
+      fprintf(stderr, "%s: truncated replay\n", path);
+      return -1;
+    }
+    game_step(game, replay_input(replay));
+  }
+  return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+typedef struct Worker {
+  Pool *pool;
+  int id;
+} Worker;
+
+static int take(Pool *pool, int id);
+static void *work(void *arg);
+
+// stops the workers and frees the pool; a batch in progress is finished first
+void pool_free(Pool *pool) {
+  int i;
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+  i = 0;
+  while (i < pool->threads)
+    pthread_join(pool->ids[i++], NULL);
+  i = 0;
+  while (i < pool->threads) {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i++].tasks);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  free(pool->deques);
+  free(pool->ids);
+}
+
+// starts threads workers, returns 0 or -1 if they could not all be started
+int pool_new(Pool *pool, int threads) {
+  Worker *worker;
+  int i;
+  pool->threads = 0;
+  pool->ids = malloc(threads * sizeof(pthread_t));
+  pool->deques = calloc(threads, sizeof(Deque));
+  if (pool->ids == NULL || pool->deques == NULL) {
+    fprintf(stderr, "pool: out of memory for %d threads\n", threads);
+    free(pool->ids);
+    free(pool->deques);
+    return -1;
+  }
+  pool->capacity = 0;
+  pool->batch = 0;
+  pool->pending = 0;
+  pool->quit = 0;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  i = 0;
+  while (i < threads)
+    pthread_mutex_init(&pool->deques[i++].lock, NULL);
+  while (pool->threads < threads) {
+    if ((worker = malloc(sizeof(Worker))) == NULL) {
+      fprintf(stderr, "pool: out of memory for thread %d\n", pool->threads);
+      pool_free(pool);
+      return -1;
+    }
+    worker->pool = pool;
+    worker->id = pool->threads;
+    if (pthread_create(&pool->ids[pool->threads], NULL, work, worker) != 0) {
+      fprintf(stderr, "pool: could not start thread %d\n", pool->threads);
+      free(worker);
+      pool_free(pool); // joins the ones that started
+      return -1;
+    }
+    ++pool->threads;
+  }
+  return 0;
+}
+
+/*
+ * Runs task(arg, i) for every i below n on the workers, and returns 0 when
+ * all are done, or -1, running none, if there is no memory to deal them.
+ */
+int pool_run(Pool *pool, int n, Task task, void *arg) {
+  Deque *deque;
+  int *tasks;
+  int i, k;
+  /*
+   * The last batch is over, so every deque is empty; a worker still looking
+   * through them reads a task only when top < bottom, so never the old array.
+   */
+  k = 0;
+  while (n > pool->capacity && k < pool->threads) {
+    if ((tasks = malloc(n * sizeof(int))) == NULL) {
+      fprintf(stderr, "pool: out of memory for %d tasks\n", n);
+      return -1;
+    }
+    deque = &pool->deques[k++];
+    pthread_mutex_lock(&deque->lock);
+    free(deque->tasks);
+    deque->tasks = tasks;
+    pthread_mutex_unlock(&deque->lock);
+  }
+  if (n > pool->capacity)
+    pool->capacity = n;
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->arg = arg;
+  pool->pending = n;
+  pthread_mutex_unlock(&pool->lock);
+  // a worker may still be looking for work from the last batch, so the deques are locked
+  k = 0;
+  while (k < pool->threads) {
+    deque = &pool->deques[k];
+    pthread_mutex_lock(&deque->lock);
+    deque->top = 0;
+    deque->bottom = 0;
+    i = (long) n * k / pool->threads;
+    while (i < (long) n * (k + 1) / pool->threads)
+      deque->tasks[deque->bottom++] = i++;
+    pthread_mutex_unlock(&deque->lock);
+    ++k;
+  }
+  pthread_mutex_lock(&pool->lock);
+  ++pool->batch;
+  pthread_cond_broadcast(&pool->start);
+  while (pool->pending > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+  return 0;
+}
+
+// a task from the worker's own deque, else one stolen from another, else -1
+static int take(Pool *pool, int id) {
+  Deque *deque;
+  int i, k, task;
+  i = 0;
+  while (i < pool->threads) {
+    k = (id + i) % pool->threads;
+    deque = &pool->deques[k];
+    task = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->top < deque->bottom)
+      task = (k == id) ? deque->tasks[--deque->bottom] : deque->tasks[deque->top++];
+    pthread_mutex_unlock(&deque->lock);
+    if (task >= 0)
+      return task;
+    ++i;
+  }
+  return -1;
+}
+
+/*
+ * A worker waits for a batch, runs tasks until none is left anywhere, then
+ * waits for the next. Tasks are whole games, so a lock per deque costs
+ * nothing next to them.
+ */
+static void *work(void *arg) {
+  Worker *worker = arg;
+  Pool *pool = worker->pool;
+  long seen = 0;
+  int task, done;
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->batch == seen && pool->quit == 0)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if (pool->batch == seen) { // quitting, between batches
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    seen = pool->batch;
+    pthread_mutex_unlock(&pool->lock);
+    done = 0;
+    while ((task = take(pool, worker->id)) >= 0) {
+      pool->task(pool->arg, task);
+      ++done;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->pending -= done;
+    if (pool->pending == 0)
+      pthread_cond_signal(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  free(worker);
+  return NULL;
+}
@@ -0,0 +1,62 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+// one run of a batch: task(arg, i) for the i-th task
+typedef void (*Task)(void *arg, int i);
+
+// a worker's share of the batch: it takes from the bottom, thieves from the top
+typedef struct Deque {
+  pthread_mutex_t lock;
+  int *tasks;
+  int top, bottom;
+} Deque;
+
+/*
+ * A fixed set of worker threads that run batches of independent tasks. Each
+ * batch is dealt out in contiguous blocks, one per worker, and a worker that
+ * runs out steals from the others, so long tasks do not leave cores idle.
+ */
+typedef struct Pool {
+  int threads;
+  pthread_t *ids;
+  Deque *deques;
+  int capacity;
+  pthread_mutex_t lock;
+  pthread_cond_t start, done;
+  // batches started so far, and tasks of the current one not finished yet
+  long batch;
+  int pending;
+  int quit;
+  Task task;
+  void *arg;
+} Pool;
+
+void pool_free(Pool *pool);
+int pool_new(Pool *pool, int threads);
+int pool_run(Pool *pool, int n, Task task, void *arg);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "replay.h"
+
+#define REPLAY_VERSION 1
+
+static int read_record(Replay *replay);
+static int read_u64(FILE *file, uint64_t *n);
+static int read_varint(FILE *file, long *n);
+static void write_u64(FILE *file, uint64_t n);
+static void write_varint(FILE *file, long n);
+
+// FNV-1a over the occupancy words and the cell plane
+uint64_t board_hash(const Board *board) {
+  const uint8_t *p = (const uint8_t *) board->rows;
+  uint64_t hash = 14695981039346656037ULL;
+  size_t i = 0;
+  int x, y;
+  while (i < sizeof(board->rows)) {
+    hash ^= p[i++];
+    hash *= 1099511628211ULL;
+  }
+  // a byte per cell, as the board used to keep them, so recorded hashes still match
+  y = 0;
+  while (y < BOARD_HEIGHT) {
+    x = 0;
+    while (x < BOARD_WIDTH) {
+      hash ^= board_cell(board, x++, y);
+      hash *= 1099511628211ULL;
+    }
+    ++y;
+  }
+  return hash;
+}
+
+// writes the end record and closes a recording
+void replay_close(Replay *replay, Game *game) {
+  write_varint(replay->file, replay->tick - replay->last);
+  fputc(0, replay->file);
+  write_varint(replay->file, game->lines);
+  write_u64(replay->file, board_hash(&game->board));
+  fclose(replay->file);
+}
+
+int replay_create(Replay *replay, const char *path, uint64_t seed, int randomizer) {
+  if ((replay->file = fopen(path, "wb")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  fwrite("TTRP", 1, 4, replay->file);
+  fputc(REPLAY_VERSION, replay->file);
+  write_u64(replay->file, seed);
+  fputc(randomizer, replay->file);
+  replay->tick = 0;
+  replay->last = 0;
+  return 0;
+}
+
+// 1 once playback has gone through every tick of the recording
+int replay_done(Replay *replay) {
+  return replay->end >= 0 && replay->tick >= replay->end;
+}
+
+// the input recorded for the next tick
+int replay_input(Replay *replay) {
+  int input = 0;
+  if (replay->tick == replay->next) {
+    input = replay->input;
+    if (read_record(replay) != 0)
+      replay->next = -1;
+  }
+  ++replay->tick;
+  return input;
+}
+
+int replay_open(Replay *replay, const char *path, uint64_t *seed, int *randomizer) {
+  char magic[5];
+  if ((replay->file = fopen(path, "rb")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  if (fread(magic, 1, 5, replay->file) != 5 || memcmp(magic, "TTRP", 4) != 0 || magic[4] != REPLAY_VERSION ||
+    read_u64(replay->file, seed) != 0 || (*randomizer = fgetc(replay->file)) == EOF) {
+    fprintf(stderr, "%s: not a replay\n", path);
+    fclose(replay->file);
+    return -1;
+  }
+  replay->tick = 0;
+  replay->next = 0;
+  replay->end = -1;
+  if (read_record(replay) != 0) {
+    fprintf(stderr, "%s: truncated replay\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+// records the input of the tick about to run, if there is any
+void replay_write(Replay *replay, int input) {
+  if (input != 0) {
+    write_varint(replay->file, replay->tick - replay->last);
+    fputc(input, replay->file);
+    replay->last = replay->tick;
+  }
+  ++replay->tick;
+}
+
+/*
+ * Reads the record after the current one. The end record closes the file,
+ * and so does a record that cannot be read, so that a truncated replay is
+ * not left open.
+ */
+static int read_record(Replay *replay) {
+  long delta;
+  int input;
+  if (replay->file == NULL)
+    return -1;
+  if (read_varint(replay->file, &delta) != 0 || (input = fgetc(replay->file)) == EOF) {
+    fclose(replay->file);
+    replay->file = NULL;
+    return -1;
+  }
+  if (input != 0) {
+    replay->next += delta;
+    replay->input = input;
+    return 0;
+  }
+  replay->end = replay->next + delta;
+  replay->next = -1;
+  // without the line count and hash there is no end to check against
+  if (read_varint(replay->file, &delta) != 0 || read_u64(replay->file, &replay->hash) != 0)
+    replay->end = -1;
+  replay->lines = delta;
+  fclose(replay->file);
+  replay->file = NULL;
+  return (replay->end < 0) ? -1 : 0;
+}
+
+static int read_u64(FILE *file, uint64_t *n) {
+  uint8_t bytes[8];
+  int i;
+  if (fread(bytes, 1, 8, file) != 8)
+    return -1;
+  *n = 0;
+  i = 8;
+  while (i > 0)
+    *n = (*n << 8) | bytes[--i];
+  return 0;
+}
+
+static int read_varint(FILE *file, long *n) {
+  int byte, shift;
+  *n = 0;
+  shift = 0;
+  do {
+    if ((byte = fgetc(file)) == EOF || shift > 56)
+      return -1;
+    *n |= (long) (byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return 0;
+}
+
+static void write_u64(FILE *file, uint64_t n) {
+  int i = 0;
+  while (i++ < 8) {
+    fputc(n & 0xff, file);
+    n >>= 8;
+  }
+}
+
+static void write_varint(FILE *file, long n) {
+  while (n >= 0x80) {
+    fputc((n & 0x7f) | 0x80, file);
+    n >>= 7;
+  }
+  fputc(n, file);
+}
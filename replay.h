@@ -0,0 +1,59 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+
+#include "engine.h"
+
+/*
+ * A replay file starts with "TTRP", a version byte, the seed as 8 little
+ * endian bytes and the randomizer byte. Then comes one record per tick that
+ * had input: the ticks since the previous record as a LEB128 varint, and the
+ * input byte. A record with input 0 ends the file: its delta gives the last
+ * tick, and it is followed by the final line count as a varint and the board
+ * hash as 8 little endian bytes, so playback can check where it ends.
+ */
+typedef struct Replay {
+  FILE *file;
+  long tick;
+  // playback: tick and input of the next record, and the last tick once known
+  long next;
+  int input;
+  long end;
+  int lines;
+  uint64_t hash;
+  // recording: tick of the last record written
+  long last;
+} Replay;
+
+uint64_t board_hash(const Board *board);
+void replay_close(Replay *replay, Game *game);
+int replay_create(Replay *replay, const char *path, uint64_t seed, int randomizer);
+int replay_done(Replay *replay);
+int replay_input(Replay *replay);
+int replay_open(Replay *replay, const char *path, uint64_t *seed, int *randomizer);
+void replay_write(Replay *replay, int input);
+
+#endif
@@ -0,0 +1,363 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Hosts headless games for clients on a Unix domain socket, one game per
+ * connection, speaking the protocol in session.h. One thread does it all:
+ * an epoll loop accepts clients and reads their inputs, and a timerfd
+ * ticks every game together, rate times a second, queueing for each client
+ * what changed, and writes each client's queue every batch ticks. Every
+ * second the tick times go to stderr.
+ */
+
+#define _GNU_SOURCE // accept4()
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#include "histogram.h"
+#include "session.h"
+
+#define DEFAULT_SOCKET "tetris.sock"
+#define DEFAULT_RATE 60
+#define DEFAULT_BATCH 1
+#define MAX_EVENTS 256
+// states queued for a client whose socket is full; past that they are dropped
+#define OUT_SIZE (4 * MSG_MAX)
+
+typedef struct Client {
+  Session session;
+  int fd;
+  // where it is in the server's list, and whether it has started a game
+  int slot, started;
+  // a partly received message, and the states not yet taken by the socket
+  uint8_t in[16];
+  int in_len;
+  uint8_t out[OUT_SIZE];
+  int out_len;
+  int waiting;
+} Client;
+
+typedef struct Server {
+  int epoll, listen, timer;
+  Client **clients;
+  int count, size;
+  uint32_t tick;
+  /*
+   * Engine ticks per server tick, so games run at their normal speed: each
+   * tick takes TICK_RATE / rate of them and carries the remainder, so that a
+   * second is TICK_RATE of them whatever the rate.
+   */
+  int rate, carry;
+  /*
+   * Ticks between writes to a client. Writes cost far more than ticking a
+   * game, so batching them is what lets a tick serve many clients; clients
+   * take their turns by slot, so each tick writes to a batch-th of them.
+   */
+  int batch;
+  // over the current second: tick times, states and bytes sent, states dropped, ticks missed
+  Histogram ticks_ns;
+  long states, bytes, dropped, missed;
+} Server;
+
+static void client_accept(Server *server);
+static void client_close(Server *server, Client *client);
+static int client_flush(Server *server, Client *client);
+static int client_read(Client *client);
+static uint64_t now();
+static void server_report(Server *server);
+static void server_tick(Server *server);
+static void watch(Server *server, Client *client, int out);
+
+int main(int argc, char **argv) {
+  Server server;
+  struct sockaddr_un addr;
+  struct epoll_event event, events[MAX_EVENTS];
+  struct itimerspec interval;
+  struct rlimit limit;
+  const char *path;
+  Client *client;
+  uint64_t expirations, second;
+  int batch, i, n, rate;
+  path = DEFAULT_SOCKET;
+  rate = DEFAULT_RATE;
+  batch = DEFAULT_BATCH;
+  i = 1;
+  while (i < argc) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      path = argv[++i];
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc && (rate = atoi(argv[i + 1])) > 0 && rate <= TICK_RATE)
+      ++i;
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc && (batch = atoi(argv[i + 1])) > 0 && batch <= OUT_SIZE / MSG_MAX)
+      ++i;
+    else {
+      fprintf(stderr, "usage: %s [-s socket] [-r rate] [-b batch]\n", argv[0]);
+      return 2;
+    }
+    ++i;
+  }
+  memset(&server, 0, sizeof(server));
+  server.rate = rate;
+  server.batch = batch;
+  // a descriptor per client
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return 1;
+  }
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if ((server.listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0 ||
+    bind(server.listen, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(server.listen, SOMAXCONN) != 0) {
+    perror(path);
+    return 1;
+  }
+  if ((server.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) < 0 || (server.epoll = epoll_create1(0)) < 0) {
+    perror("server");
+    return 1;
+  }
+  interval.it_interval.tv_sec = 1000000000L / rate / 1000000000;
+  interval.it_interval.tv_nsec = 1000000000L / rate % 1000000000;
+  interval.it_value = interval.it_interval;
+  if (timerfd_settime(server.timer, 0, &interval, NULL) != 0) {
+    perror("timerfd_settime");
+    return 1;
+  }
+  // the listening socket and the timer are told from clients by their pointers
+  event.events = EPOLLIN;
+  event.data.ptr = &server.listen;
+  if (epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listen, &event) != 0) {
+    perror("epoll_ctl");
+    return 1;
+  }
+  event.data.ptr = &server.timer;
+  if (epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.timer, &event) != 0) {
+    perror("epoll_ctl");
+    return 1;
+  }
+  fprintf(stderr, "listening on %s, %d ticks/s, writes every %d\n", path, rate, batch);
+  second = now();
+  while (1) {
+    n = epoll_wait(server.epoll, events, MAX_EVENTS, -1);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      return 1;
+    }
+    i = 0;
+    while (i < n) {
+      if (events[i].data.ptr == &server.listen)
+        client_accept(&server);
+      else if (events[i].data.ptr == &server.timer) {
+        // a late tick is counted, not caught up, which would only make it later
+        if (read(server.timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+          server.missed += expirations - 1;
+          server_tick(&server);
+        }
+      }
+      else {
+        client = events[i].data.ptr;
+        if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0 ||
+          ((events[i].events & EPOLLIN) != 0 && client_read(client) != 0) ||
+          ((events[i].events & EPOLLOUT) != 0 && client_flush(&server, client) != 0)) {
+          client_close(&server, client);
+        }
+      }
+      ++i;
+    }
+    if (now() - second >= 1000000000) {
+      server_report(&server);
+      second = now();
+    }
+  }
+  return 0;
+}
+
+static void client_accept(Server *server) {
+  struct epoll_event event;
+  Client *client;
+  int fd;
+  while ((fd = accept4(server->listen, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+    if ((client = calloc(1, sizeof(Client))) == NULL) {
+      close(fd);
+      return;
+    }
+    if (server->count == server->size) {
+      server->size = server->size * 2 + 64;
+      server->clients = realloc(server->clients, server->size * sizeof(Client *));
+    }
+    client->fd = fd;
+    client->slot = server->count;
+    server->clients[server->count++] = client;
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event);
+  }
+  if (errno != EAGAIN && errno != EWOULDBLOCK)
+    perror("accept");
+}
+
+// the last client takes the slot of the one that leaves
+static void client_close(Server *server, Client *client) {
+  close(client->fd);
+  server->clients[client->slot] = server->clients[--server->count];
+  server->clients[client->slot]->slot = client->slot;
+  free(client);
+}
+
+// sends what the socket takes, and watches it for room when some is left
+static int client_flush(Server *server, Client *client) {
+  ssize_t n;
+  n = send(client->fd, client->out, client->out_len, MSG_NOSIGNAL);
+  if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    return -1;
+  if (n > 0) {
+    server->bytes += n;
+    client->out_len -= n;
+    memmove(client->out, client->out + n, client->out_len);
+  }
+  if ((client->out_len > 0) != client->waiting)
+    watch(server, client, client->out_len > 0);
+  return 0;
+}
+
+// handles the whole messages received so far; -1 closes the client
+static int client_read(Client *client) {
+  uint64_t seed;
+  ssize_t n;
+  int i, size;
+  while ((n = recv(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len, 0)) > 0) {
+    client->in_len += n;
+    while (client->in_len >= 2 && client->in_len >= 2 + (size = client->in[0] | client->in[1] << 8)) {
+      if (size == 2 && client->in[2] == MSG_INPUT && client->started == 1)
+        client->session.input |= client->in[3];
+      else if (size == 10 && client->in[2] == MSG_NEW) {
+        seed = 0;
+        i = 8;
+        while (i-- > 0)
+          seed = seed << 8 | client->in[3 + i];
+        session_new(&client->session, seed, client->in[11]);
+        client->started = 1;
+      }
+      else
+        return -1;
+      client->in_len -= 2 + size;
+      memmove(client->in, client->in + 2 + size, client->in_len);
+    }
+    if (client->in_len == sizeof(client->in))
+      return -1;
+  }
+  return (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) ? -1 : 0;
+}
+
+static uint64_t now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void server_report(Server *server) {
+  fprintf(stderr, "%d clients, tick p50 %llu us, p99 %llu us, max %llu us, %ld states, %ld KB sent, %ld dropped, "
+    "%ld ticks missed\n", server->count,
+    (unsigned long long) histogram_percentile(&server->ticks_ns, 50) / 1000,
+    (unsigned long long) histogram_percentile(&server->ticks_ns, 99) / 1000,
+    (unsigned long long) server->ticks_ns.max / 1000, server->states, server->bytes / 1024, server->dropped,
+    server->missed);
+  histogram_clear(&server->ticks_ns);
+  server->states = 0;
+  server->bytes = 0;
+  server->dropped = 0;
+  server->missed = 0;
+}
+
+/*
+ * Steps every game and queues what changed for its client, writing the
+ * queue out when it is the client's turn. A client that has not taken its
+ * earlier states misses this one, and is sent every row once it has caught
+ * up.
+ */
+static void server_tick(Server *server) {
+  uint8_t scratch[MSG_MAX];
+  Client *client;
+  uint64_t start;
+  int i, n, steps;
+  start = now();
+  ++server->tick;
+  server->carry += TICK_RATE;
+  steps = server->carry / server->rate;
+  server->carry %= server->rate;
+  i = 0;
+  while (i < server->count) {
+    client = server->clients[i];
+    if (client->started == 0) {
+      ++i;
+      continue;
+    }
+    if (OUT_SIZE - client->out_len >= MSG_MAX) {
+      n = session_tick(&client->session, steps, server->tick, start, client->out + client->out_len);
+      client->out_len += n;
+    }
+    else {
+      n = session_tick(&client->session, steps, server->tick, start, scratch);
+      if (n > 0) {
+        client->session.full = 1;
+        ++server->dropped;
+      }
+      n = 0;
+    }
+    if (n > 0)
+      ++server->states;
+    /*
+     * A client waiting for room is flushed when epoll says there is some.
+     * One whose socket failed stops playing, and is closed when epoll
+     * reports it, since it may be among the events still to handle.
+     */
+    if (client->out_len > 0 && client->waiting == 0 && (server->tick + i) % server->batch == 0 &&
+      client_flush(server, client) != 0)
+      client->started = 0;
+    ++i;
+  }
+  histogram_add(&server->ticks_ns, now() - start);
+}
+
+// watches a client's socket for input, and for room to send when out is set
+static void watch(Server *server, Client *client, int out) {
+  struct epoll_event event;
+  event.events = EPOLLIN | (out ? EPOLLOUT : 0);
+  event.data.ptr = client;
+  if (client->waiting != out)
+    epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event);
+  client->waiting = out;
+}
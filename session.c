@@ -0,0 +1,150 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "session.h"
+
+static uint64_t get(const uint8_t *p, int bytes);
+static uint8_t *put(uint8_t *p, uint64_t n, int bytes);
+
+/*
+ * Brings a client's copy of the game up to date with a MSG_STATE message,
+ * length included, and returns 0, or -1 if the message is malformed. Only
+ * what is drawn is kept: the board, the falling shape, the counters and the
+ * next shape.
+ */
+int session_apply(Game *mirror, const uint8_t *msg, int size, uint32_t *tick, uint64_t *stamp) {
+  int i, n, x, y;
+  if (size < MSG_STATE_HEADER || msg[2] != MSG_STATE || (int) get(msg, 2) != size - 2)
+    return -1;
+  n = msg[MSG_STATE_HEADER - 1];
+  if (size != MSG_STATE_HEADER + n * (1 + BOARD_WIDTH / 2))
+    return -1;
+  *tick = get(msg + 3, 4);
+  *stamp = get(msg + 7, 8);
+  mirror->falling.type = msg[15];
+  mirror->falling.angle = msg[16];
+  mirror->falling.x = (int16_t) get(msg + 17, 2);
+  mirror->falling.y = (int16_t) get(msg + 19, 2);
+  mirror->lines = get(msg + 21, 2);
+  mirror->level = msg[23];
+  mirror->over = msg[24] & 1;
+  mirror->paused = (msg[24] >> 1) & 1;
+  mirror->queue[0] = msg[25];
+  msg += MSG_STATE_HEADER;
+  i = 0;
+  while (i++ < n) {
+    y = *msg++;
+    if (y >= BOARD_HEIGHT)
+      return -1;
+    memcpy(mirror->board.cells[y], msg, BOARD_WIDTH / 2);
+    msg += BOARD_WIDTH / 2;
+    // the occupancy bits follow from the cells
+    mirror->board.rows[y] = ROW_EMPTY;
+    x = 0;
+    while (x < BOARD_WIDTH) {
+      if (board_cell(&mirror->board, x, y) != 0)
+        mirror->board.rows[y] |= 1u << (x + BOARD_WALL);
+      ++x;
+    }
+  }
+  if (n > 0)
+    board_tops(&mirror->board);
+  return 0;
+}
+
+void session_new(Session *session, uint64_t seed, int randomizer) {
+  game_new(&session->game, seed, randomizer);
+  session->input = 0;
+  session->full = 1;
+}
+
+/*
+ * Runs steps ticks of the game, the input received since the last call
+ * acting on the first, and writes into out, MSG_MAX bytes, the MSG_STATE
+ * message that tells the client what changed. Returns its length, or 0 when
+ * nothing did and there is nothing to send.
+ */
+int session_tick(Session *session, int steps, uint32_t tick, uint64_t stamp, uint8_t *out) {
+  Game *game = &session->game;
+  uint8_t *p;
+  int flags, n, y;
+  game_step(game, session->input);
+  session->input = 0;
+  while (--steps > 0)
+    game_step(game, 0);
+  flags = game->over | game->paused << 1;
+  n = 0;
+  p = out + MSG_STATE_HEADER;
+  y = 0;
+  while (y < BOARD_HEIGHT) {
+    if (session->full == 1 || memcmp(session->sent_cells[y], game->board.cells[y], BOARD_WIDTH / 2) != 0) {
+      *p++ = y;
+      memcpy(p, game->board.cells[y], BOARD_WIDTH / 2);
+      memcpy(session->sent_cells[y], game->board.cells[y], BOARD_WIDTH / 2);
+      p += BOARD_WIDTH / 2;
+      ++n;
+    }
+    ++y;
+  }
+  if (n == 0 && memcmp(&session->sent_falling, &game->falling, sizeof(Shape)) == 0 &&
+    session->sent_lines == game->lines && session->sent_level == game->level && session->sent_flags == flags &&
+    session->sent_next == game->queue[0])
+    return 0;
+  session->full = 0;
+  session->sent_falling = game->falling;
+  session->sent_lines = game->lines;
+  session->sent_level = game->level;
+  session->sent_flags = flags;
+  session->sent_next = game->queue[0];
+  put(out, p - out - 2, 2);
+  out[2] = MSG_STATE;
+  put(out + 3, tick, 4);
+  put(out + 7, stamp, 8);
+  out[15] = game->falling.type;
+  out[16] = game->falling.angle;
+  put(out + 17, (uint16_t) game->falling.x, 2);
+  put(out + 19, (uint16_t) game->falling.y, 2);
+  put(out + 21, game->lines, 2);
+  out[23] = game->level;
+  out[24] = flags;
+  out[25] = game->queue[0];
+  out[26] = n;
+  return p - out;
+}
+
+// a little endian number of bytes bytes
+static uint64_t get(const uint8_t *p, int bytes) {
+  uint64_t n = 0;
+  while (bytes-- > 0)
+    n = n << 8 | p[bytes];
+  return n;
+}
+
+static uint8_t *put(uint8_t *p, uint64_t n, int bytes) {
+  while (bytes-- > 0) {
+    *p++ = n & 0xff;
+    n >>= 8;
+  }
+  return p;
+}
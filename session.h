@@ -0,0 +1,65 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+/*
+ * A session is a game played over a socket. Every message is a 16-bit
+ * length, counting what follows it, then a type byte and its fields, all
+ * little endian. The client sends MSG_NEW with a seed (8 bytes) and a
+ * randomizer byte to start a game, over again if one is going, and
+ * MSG_INPUT with input bits (1 byte) to have them act on the next tick.
+ * After every tick that changed something the server sends MSG_STATE: the
+ * tick (4 bytes), the server's monotonic clock when the tick began (8), the
+ * falling shape's type and angle (1 each), x and y (2 each, signed), the
+ * lines (2), the level, flags (1 over, 2 paused) and next shape (1 each),
+ * then a row count (1) and, for each row whose cells changed, its index (1)
+ * and its cells as the board packs them.
+ */
+#define MSG_NEW 'N'
+#define MSG_INPUT 'I'
+#define MSG_STATE 'S'
+#define MSG_STATE_HEADER 27
+#define MSG_MAX (MSG_STATE_HEADER + BOARD_HEIGHT * (1 + BOARD_WIDTH / 2))
+
+typedef struct Session {
+  Game game;
+  // input bits received since the last tick
+  int input;
+  // the client has seen nothing yet, or missed a state, and needs every row
+  int full;
+  // what the client was last sent
+  uint8_t sent_cells[BOARD_HEIGHT][BOARD_WIDTH / 2];
+  Shape sent_falling;
+  int sent_lines, sent_level, sent_flags, sent_next;
+} Session;
+
+int session_apply(Game *mirror, const uint8_t *msg, int size, uint32_t *tick, uint64_t *stamp);
+void session_new(Session *session, uint64_t seed, int randomizer);
+int session_tick(Session *session, int steps, uint32_t tick, uint64_t stamp, uint8_t *out);
+
+#endif
@@ -20,193 +20,461 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
  
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_gfxPrimitives.h>
+#include <SDL_ttf.h>
 
-#define BLOCK_SIZE 20
-#define FALL_STEP 1
-#define LETTER_A 0
-#define LETTER_B 1
-#define LETTER_C 2
-#define LETTER_D 3
-#define LETTER_E 4
-#define LETTER_F 5
-#define LETTER_G 6
-#define LETTER_H 7
-#define LETTER_I 8
-#define LETTER_J 9
-#define LETTER_K 10
-#define LETTER_L 11
-#define LETTER_M 12
-#define LETTER_N 13
-#define LETTER_O 14
-#define LETTER_P 15
-#define LETTER_Q 16
-#define LETTER_R 17
-#define LETTER_S 18
-#define LETTER_T 19
-#define LETTER_U 20
-#define LETTER_V 21
-#define LETTER_W 22
-#define LETTER_X 23
-#define LETTER_Y 24
-#define LETTER_Z 25
-#define WALL_WIDTH 400
-#define WALL_HEIGHT 600
-#define PTR_NULL ((void *) 0)
+#include "ai.h"
+#include "blit.h"
+#include "bundle.h"
+#include "capture.h"
+#include "engine.h"
+#include "histogram.h"
+#include "input.h"
+#include "replay.h"
+#include "triple.h"
+
+#define BUNDLE_PATH "images.pak"
 #define SCREEN_WIDTH 600
 #define SCREEN_HEIGHT 600
-#define SPEED 7
-
-typedef struct Game {
-  int delay;
-  int level;
-  int lines;
-  int over;
-  int paused;
-  int running;
-  SDL_Surface *digits[10];
-  SDL_Surface *letters[26];
+#define PANEL_WIDTH (SCREEN_WIDTH - WALL_WIDTH)
+// the atlas holds the digits then the letters, each in a cell this size
+#define GLYPHS 36
+#define GLYPH_WIDTH 12
+#define GLYPH_HEIGHT 23
+#define MAX_DIRTY 64
+#define TICK_NS (1000000000 / TICK_RATE)
+// after a stall, at most this much simulation is caught up
+#define MAX_CATCH_UP 250000000
+// frames are captured every so many ticks, 30 a second
+#define CAPTURE_TICKS (TICK_RATE / 30)
+// the parts of a frame that are timed, see view_phase(), and PHASE_STEP, each tick
+#define PHASE_EVENTS 0
+#define PHASE_STEP 1
+#define PHASE_ERASE 2
+#define PHASE_BLOCKS 3
+#define PHASE_SHAPE 4
+#define PHASE_RIGHT 5
+#define PHASE_UPDATE 6
+#define PHASE_SLEEP 7
+#define PHASES 8
+
+/*
+ * One game on the screen: the engine's state, what drives it, and the
+ * viewport and panel fields it is drawn into. Drawing works in coordinates
+ * relative to the viewport's corner, and from shown: game belongs to the
+ * simulation thread, which only lets the drawing see copies of it.
+ */
+typedef struct Player {
+  Game game;
+  const Game *shown;
+  Uint64 seed;
+  int randomizer;
+  int x, y;
+  // the session being recorded and the one being played back, if any
+  Replay *record, *play;
+  // with autoplay, where the AI steers the falling shape, planned for which piece
+  int autoplay;
+  Placement target;
+  int planned;
+  // the panel fields, drawn again only when the value they show changes
+  SDL_Surface *preview, *lines_field, *level_field;
+  int hud_lines, hud_level, hud_next;
+  // what the viewport shows now, compared with the game to find what to redraw
+  int drawn_mode;
+  int drawn_lines, drawn_level, drawn_next;
+  Uint8 drawn_cells[BOARD_HEIGHT][BOARD_WIDTH / 2];
+  Shape drawn_falling, drawn_ghost;
+  int drawn_overlay, drawn_overlay_us[3];
+  SDL_Rect dirty[MAX_DIRTY];
+  int ndirty;
+} Player;
+
+/*
+ * What the simulation thread publishes after every tick: every game as it
+ * stands, and the simulation's figures over its last whole second.
+ */
+typedef struct Snapshot {
+  long ticks;
+  int jitter_us;
+  long ai_rate;
+  int ai_us;
+  Game games[];
+} Snapshot;
+
+// the SDL front end: a client of the engine in engine.c
+typedef struct View {
+  atomic_int running;
+  // live surfaces loaded by get_image(), and their pixel memory in bytes
+  int surfaces;
+  long bytes;
+  // the images decoded ahead of time, when there is a bundle
+  Bundle bundle;
+  int bundled;
+  // every glyph side by side in one surface, and where each one is
+  SDL_Surface *atlas;
+  SDL_Rect glyphs[GLYPHS];
+  SDL_Surface *tiles[7];
+  // the same tiles' pixels, for blit_tile(), and darker ones for the ghost shape
+  Uint32 tile_pixels[7][TILE_PIXELS];
+  Uint32 ghost_pixels[7][TILE_PIXELS];
+  // the part of the right panel that never changes, composed once and shared
+  SDL_Surface *hud;
   SDL_Surface *screen;
-  struct Shape *falling, *next;
-  struct SDL_Surface *grid[SCREEN_WIDTH][SCREEN_HEIGHT];
-} Game;
-
-typedef struct Shape {
-  // each shape consists in four squares, located by the upper left corner
-  SDL_Rect pos[4];
-  SDL_Surface *img;
+  // the games, laid out left to right then top to bottom; the keys drive the first
+  Player *players;
+  int count;
+  // key events on their way from the drawing thread to the ticks
+  Input keys;
+  // the simulation thread, and the snapshots it leaves for the drawing, the one drawn last shown
+  pthread_t simulation;
+  Triple snapshots;
+  const Snapshot *shown;
+  // ticks run so far, and the frames being captured, if they are
+  long ticks;
+  Capture *capture;
+  long captured;
+  // frame times over the current second, in nanoseconds, and the previous second's figures
+  Uint64 second_start, last_frame, frame_max;
+  int frames;
+  int fps, frame_us, frame_max_us;
   /*
-   * type 0 : g.jpg
-   * type 1 : i.jpg
-   * type 2 : l.jpg
-   * type 3 : o.jpg
-   * type 4 : s.jpg
-   * type 5 : t.jpg
-   * type 6 : z.jpg
+   * the simulation's: tick lateness and the AI's searches over its current
+   * second, and the previous second's figures it publishes
    */
-  int type;
-  int angle;
-} Shape;
+  Uint64 tick_second, jitter_max;
+  long evaluated;
+  int searches;
+  Uint64 search_ns;
+  int jitter_us;
+  long ai_rate;
+  int ai_us;
+  /*
+   * the time each phase took in the current frame, and histograms of those
+   * per frame times and of the frames themselves since the start
+   */
+  Uint64 phase_ns[PHASES];
+  Histogram phases[PHASES], frames_ns;
+  // frame times over the current second, and the previous second's percentiles the HUD can show
+  Histogram recent;
+  int overlay;
+  int overlay_us[3];
+} View;
 
-void check_lines(int y);
-void check_lost();
+void atlas_new(const char *font);
 int clean_up(int err);
-void draw_blocks();
-void draw_digit(int d, int x, int y);
-void draw_number(int n, int x, int y);
-void draw_right();
+int key_input(SDLKey key);
+void damage(Player *p, int x, int y, int w, int h);
+void damage_shape(Player *p, const Shape *from, const Shape *to);
+void draw_glyph(SDL_Surface *to, int glyph, int x, int y);
+void draw_number(SDL_Surface *to, int n, int x, int y);
+void draw_right(Player *p);
+void draw_text(SDL_Surface *to, const char *text, int x, int y);
+void free_image(SDL_Surface *image);
 SDL_Surface *get_image(char *str);
-void empty_line(int y);
-void erase_screen();
-void falling_next();
-int flip_checking(SDL_Rect pos[]);
-void game_new();
-void game_over();
-void game_pause();
-int min(int y1, int y2, int y3, int y4);
-void move_left();
-void move_right();
-void shape_draw();
-void shape_fall();
-void shape_flip(int clockwise);
-void shape_new();
-
-Game *game;
+void erase_area(SDL_Rect *area);
+void game_over(Player *p);
+void game_pause(Player *p);
+void hud_new();
+void hud_update(Player *p);
+SDL_Surface *new_surface(int w, int h);
+Uint64 now();
+void player_free(Player *p);
+void player_new(Player *p, Uint64 seed, int randomizer, int x, int y);
+void player_tick(Player *p, int input);
+void redraw(Player *p, SDL_Rect *area, int mode);
+void render(Player *p);
+void shape_draw(Player *p, const Frame *frame);
+void tile_copy(SDL_Surface *image, Uint32 pixels[TILE_PIXELS]);
+int view_autoplay(Player *p);
+void view_bench(int frames);
+void view_capture(long ticks, int wait);
+void view_export();
+void view_free();
+void view_new(const char *font);
+Uint64 view_phase(int phase, Uint64 since);
+void view_publish();
+void *view_simulate(void *unused);
+void view_stats();
+void view_timing(Uint64 frame_end);
+
+View *view;
+const char *phase_names[PHASES] = {
+  "events", "tick", "erase_area", "draw_blocks", "shape_draw", "draw_right", "SDL_UpdateRects", "sleep"
+};
 
 int main(int argc, char **argv) {
   SDL_Event event;
-  Uint8 *keystate;
-  game = malloc(sizeof(struct Game));
-  game_new();
+  Uint64 t, next_frame, started, images;
+  struct timespec wait;
+  Uint64 seed;
+  Replay record, play;
+  Capture capture;
+  char *record_path, *play_path, *csv_path, *font, *export;
+  FILE *csv;
+  int i, key, randomizer, autoplay, frames, das, arr, count, columns;
+  started = now();
+  seed = started;
+  randomizer = RANDOM_BAG;
+  record_path = NULL;
+  play_path = NULL;
+  csv_path = NULL;
+  font = NULL;
+  export = NULL;
+  autoplay = 0;
+  das = DEFAULT_DAS;
+  arr = DEFAULT_ARR;
+  frames = 0;
+  count = 1;
+  i = 1;
+  while (i < argc) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-u") == 0)
+      randomizer = RANDOM_UNIFORM;
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      record_path = argv[++i];
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+      play_path = argv[++i];
+    else if (strcmp(argv[i], "-a") == 0)
+      autoplay = 1;
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      csv_path = argv[++i];
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      font = argv[++i];
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+      export = argv[++i];
+    else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%d,%d", &das, &arr) == 2)
+      ++i;
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && (count = atoi(argv[i + 1])) > 0)
+      ++i;
+    else {
+      fprintf(stderr, "usage: %s [-s seed] [-u] [-a] [-n games] [-b frames] [-c csv] [-k das,arr] [-t font] "
+        "[-e frames] [-r replay | -p replay]\n", argv[0]);
+      return 1;
+    }
+    ++i;
+  }
+  view = calloc(1, sizeof(struct View));
+  view->players = calloc(count, sizeof(Player));
+  view->count = count;
+  // a replay brings its own seed
+  if (play_path != NULL && replay_open(&play, play_path, &seed, &randomizer) != 0)
+    return 1;
+  if (play_path == NULL && record_path != NULL && replay_create(&record, record_path, seed, randomizer) != 0)
+    return 1;
+  // with this, tetris -s replays the same sequence of shapes
+  fprintf(stderr, "seed %llu\n", (unsigned long long) seed);
+  // a replay is exported without a window, as fast as it draws
+  if (export != NULL && play_path != NULL)
+    setenv("SDL_VIDEODRIVER", "dummy", 1);
   if (SDL_Init(SDL_INIT_VIDEO != 0)) {
     fprintf(stderr, "Could not initialize SDL: %s\n", SDL_GetError());
     return 1;
   }
-  if ((game->screen = SDL_SetVideoMode(SCREEN_WIDTH, SCREEN_HEIGHT, 8, SDL_SWSURFACE)) == NULL) {
+  // as square a grid as the games fill
+  columns = 1;
+  while (columns * columns < count)
+    ++columns;
+  if ((view->screen = SDL_SetVideoMode(columns * SCREEN_WIDTH, (count + columns - 1) / columns * SCREEN_HEIGHT, 32,
+    SDL_SWSURFACE)) == NULL || view->screen->format->BytesPerPixel != 4) {
     fprintf(stderr, "Could not set SDL video mode: %s\n", SDL_GetError());
     return clean_up(1);
   }
-  SDL_WM_SetCaption("Tetris", "Tetris");
+  blit_init();
+  // images are converted to the display format, so the video mode comes first
+  images = now();
+  view_new(font);
+  images = now() - images;
+  input_new(&view->keys, das * TICK_RATE / 1000, arr * TICK_RATE / 1000);
+  i = 0;
+  while (i < count) {
+    player_new(&view->players[i], seed + i, randomizer, i % columns * SCREEN_WIDTH, i / columns * SCREEN_HEIGHT);
+    // the keys and replays go to the first game, the AI plays the others
+    view->players[i].autoplay = (i > 0) ? 1 : autoplay;
+    ++i;
+  }
+  if (play_path != NULL) {
+    view->players[0].play = &play;
+    // a replay already holds every input, so the AI only plays live games
+    view->players[0].autoplay = 0;
+  }
+  else if (record_path != NULL)
+    view->players[0].record = &record;
+  if (frames > 0) {
+    view_bench(frames);
+    view_free();
+    free(view->players);
+    free(view);
+    return clean_up(0);
+  }
+  if (export != NULL) {
+    if (capture_open(&capture, export, view->screen->w, view->screen->h, view->screen->format->Rshift,
+      view->screen->format->Gshift, view->screen->format->Bshift) != 0)
+      return clean_up(1);
+    view->capture = &capture;
+    if (play_path != NULL) {
+      view_export();
+      view_free();
+      free(view->players);
+      free(view);
+      return clean_up(capture.error);
+    }
+  }
+  // the drawing starts from the games as they are, and the simulation goes on from there
+  if (triple_new(&view->snapshots, sizeof(Snapshot) + count * sizeof(Game)) != 0) {
+    fprintf(stderr, "out of memory\n");
+    return clean_up(1);
+  }
+  view_publish();
+  triple_take(&view->snapshots);
+  view->shown = triple_front(&view->snapshots);
+  if (pthread_create(&view->simulation, NULL, view_simulate, NULL) != 0) {
+    fprintf(stderr, "could not start the simulation thread\n");
+    return clean_up(1);
+  }
+  view_stats();
   SDL_ShowCursor(SDL_DISABLE);
+  next_frame = now();
+  view->second_start = next_frame;
+  view->last_frame = next_frame;
+  t = next_frame;
   while (1) {
-    erase_screen();
-    if (game->paused == 1)
-      game_pause();
-    else if (game->over == 1)
-      game_over();
-    else {
-      shape_fall();
-      shape_draw();
-      draw_blocks();
-    }
-    draw_right();
-    SDL_UpdateRect(game->screen, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-    check_lost();
-    while (SDL_PollEvent(&event))
+    // keys go into the queue with the time they were seen, and act on the tick after
+    while (SDL_PollEvent(&event)) {
+      key = (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) ? key_input(event.key.keysym.sym) : 0;
       if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE))
-        game->running = 0;
-      else if (game->over == 0 && event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_p)
-        game->paused ^= 1;
-    if (game->running == 0)
+        view->running = 0;
+      else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_f)
+        view->overlay ^= 1;
+      else if (key != 0)
+        input_push(&view->keys, now(), key, event.type == SDL_KEYDOWN);
+    }
+    if (view->running == 0)
       break;
-    keystate = SDL_GetKeyState(NULL);
-    if (game->paused == 0 && game->over == 0) {
-      if (keystate[SDLK_RIGHT]) {
-        move_right();
-        keystate[SDLK_RIGHT] = 0;
-      }
-      else if (keystate[SDLK_LEFT]) {
-        move_left();
-        keystate[SDLK_LEFT] = 0;
+    /*
+     * The games tick on the simulation thread; this one draws the latest
+     * snapshot it left, if there is a new one, whatever ticks it skipped,
+     * then sleeps until the next frame is due.
+     */
+    t = view_phase(PHASE_EVENTS, t);
+    if (triple_take(&view->snapshots) == 1) {
+      view->shown = triple_front(&view->snapshots);
+      i = 0;
+      while (i < view->count) {
+        view->players[i].shown = &view->shown->games[i];
+        render(&view->players[i++]);
       }
-      else if (keystate[SDLK_UP]) {
-        shape_flip(1); // clockwise
-        keystate[SDLK_UP] = 0;
+      if (started != 0) {
+        fprintf(stderr, "started in %.2f ms, images %s in %.2f ms\n", (now() - started) / 1e6,
+          (view->bundled == 1) ? "mapped from " BUNDLE_PATH : "decoded", images / 1e6);
+        started = 0;
       }
-      else if (keystate[SDLK_DOWN]) {
-        shape_flip(0); // counter clockwise
-        keystate[SDLK_DOWN] = 0;
+      // a live game drops frames rather than wait for the disk
+      if (view->capture != NULL && view->shown->ticks / CAPTURE_TICKS != view->captured)
+        view_capture(view->shown->ticks, 0);
+      view_timing(now());
+    }
+    view_stats();
+    t = now();
+    next_frame += TICK_NS;
+    if (next_frame < t)
+      next_frame = t;
+    else {
+      wait.tv_sec = (next_frame - t) / 1000000000;
+      wait.tv_nsec = (next_frame - t) % 1000000000;
+      nanosleep(&wait, NULL);
+    }
+    t = view_phase(PHASE_SLEEP, t);
+  }
+  pthread_join(view->simulation, NULL);
+  triple_free(&view->snapshots);
+  if (view->players[0].record != NULL)
+    replay_close(view->players[0].record, &view->players[0].game);
+  if (view->capture != NULL) {
+    capture_close(view->capture);
+    fprintf(stderr, "%ld frames captured, %ld dropped\n", capture.written, capture.dropped);
+  }
+  if (csv_path != NULL) {
+    if ((csv = fopen(csv_path, "w")) == NULL)
+      perror(csv_path);
+    else {
+      fprintf(csv, "phase,low_ns,high_ns,count\n");
+      i = 0;
+      while (i < PHASES) {
+        histogram_csv(csv, phase_names[i], &view->phases[i]);
+        ++i;
       }
+      histogram_csv(csv, "frame", &view->frames_ns);
+      fclose(csv);
     }
-    if (game->delay - game->level > -1)
-      SDL_Delay(game->delay - game->level);
   }
-  free(game->falling);
-  free(game->next);
-  free(game);
+  view_free();
+  fprintf(stderr, "%d surfaces, %ld bytes still loaded\n", view->surfaces, view->bytes);
+  free(view->players);
+  free(view);
   return clean_up(0);
 }
 
-void check_lines(int y) {
-  int x, full;
-  if (y == WALL_HEIGHT)
-    return;
-  full = 1;
-  x = 0;
-  while (x < WALL_WIDTH) {
-    if (game->grid[x][y] == PTR_NULL) {
-      full = 0;
-      break;
+/*
+ * Packs every glyph into one surface: rendered from a TrueType font when
+ * one is given and loads, otherwise from the letter and digit images, which
+ * are freed once copied.
+ */
+void atlas_new(const char *font) {
+  const char *chars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  SDL_Color color = { 0, 178, 0, 0 };
+  SDL_Rect from = { 0, 0, GLYPH_WIDTH, GLYPH_HEIGHT }, to;
+  SDL_Surface *glyph;
+  TTF_Font *ttf;
+  char str[6];
+  int i;
+  ttf = NULL;
+  if (font != NULL) {
+    if (TTF_Init() != 0)
+      fprintf(stderr, "TTF_Init: %s\n", TTF_GetError());
+    else if ((ttf = TTF_OpenFont(font, GLYPH_HEIGHT - 5)) == NULL) {
+      fprintf(stderr, "TTF_OpenFont: %s\n", TTF_GetError());
+      TTF_Quit();
     }
-    x += BLOCK_SIZE;
   }
-  if (full == 1)
-    empty_line(y);
-  check_lines(y + BLOCK_SIZE);
-}
-
-void check_lost() {
-  int x = 0;
-  while (x < WALL_WIDTH) {
-    if (game->grid[x][0] != PTR_NULL)
-      game->over = 1;
-    x += BLOCK_SIZE;
+  view->atlas = new_surface(GLYPHS * GLYPH_WIDTH, GLYPH_HEIGHT);
+  SDL_FillRect(view->atlas, NULL, SDL_MapRGB(view->atlas->format, 0x00, 0x00, 0x00));
+  i = 0;
+  while (i < GLYPHS) {
+    view->glyphs[i].x = i * GLYPH_WIDTH;
+    view->glyphs[i].y = 0;
+    view->glyphs[i].w = GLYPH_WIDTH;
+    view->glyphs[i].h = GLYPH_HEIGHT;
+    to = view->glyphs[i]; // blits clip their destination rect
+    snprintf(str, sizeof(str), "%c", chars[i]);
+    if (ttf != NULL) {
+      if ((glyph = TTF_RenderText_Solid(ttf, str, color)) != NULL) {
+        SDL_BlitSurface(glyph, &from, view->atlas, &to);
+        SDL_FreeSurface(glyph);
+      }
+    }
+    else {
+      snprintf(str, sizeof(str), "%c.jpg", chars[i]);
+      glyph = get_image(str);
+      SDL_BlitSurface(glyph, &from, view->atlas, &to);
+      free_image(glyph);
+    }
+    ++i;
+  }
+  if (ttf != NULL) {
+    TTF_CloseFont(ttf);
+    TTF_Quit();
   }
 }
 
@@ -215,655 +483,682 @@ int clean_up(int err) {
   return err;
 }
 
-void draw_blocks() {
-  int x, y;
-  SDL_Rect pos = { 0, 0, 0, 0 };
-  x = 0;
-  while (x < WALL_WIDTH) {
-    y = 0;
-    while (y < WALL_HEIGHT) {
-      if (game->grid[x][y] != PTR_NULL) {
-        pos.x = x;
-	pos.y = y;
-        SDL_BlitSurface(game->grid[x][y], NULL, game->screen, &pos);
-      }
-      y += FALL_STEP;
+// the input bit a key stands for, 0 for none
+int key_input(SDLKey key) {
+  if (key == SDLK_LEFT)
+    return INPUT_LEFT;
+  if (key == SDLK_RIGHT)
+    return INPUT_RIGHT;
+  if (key == SDLK_UP)
+    return INPUT_CW;
+  if (key == SDLK_DOWN)
+    return INPUT_CCW;
+  if (key == SDLK_p)
+    return INPUT_PAUSE;
+  if (key == SDLK_SPACE)
+    return INPUT_DROP;
+  return 0;
+}
+
+void damage(Player *p, int x, int y, int w, int h) {
+  SDL_Rect rect = { x, y, w, h };
+  if (p->ndirty == MAX_DIRTY) { // too scattered, redraw the whole viewport
+    p->ndirty = 0;
+    rect.x = 0;
+    rect.y = 0;
+    rect.w = SCREEN_WIDTH;
+    rect.h = SCREEN_HEIGHT;
+  }
+  p->dirty[p->ndirty++] = rect;
+}
+
+void damage_shape(Player *p, const Shape *from, const Shape *to) {
+  Cell old[4], pos[4];
+  int i, top, bottom;
+  shape_cells(from, old);
+  shape_cells(to, pos);
+  i = 0;
+  while (i < 4) {
+    if (old[i].x == pos[i].x) { // one rect covers the square's fall
+      top = (old[i].y < pos[i].y) ? old[i].y : pos[i].y;
+      bottom = (old[i].y > pos[i].y) ? old[i].y : pos[i].y;
+      damage(p, pos[i].x, top, BLOCK_SIZE, bottom - top + BLOCK_SIZE);
     }
-    x += BLOCK_SIZE;
+    else {
+      damage(p, old[i].x, old[i].y, BLOCK_SIZE, BLOCK_SIZE);
+      damage(p, pos[i].x, pos[i].y, BLOCK_SIZE, BLOCK_SIZE);
+    }
+    ++i;
   }
 }
 
-void draw_digit(int d, int x, int y) {
+void draw_glyph(SDL_Surface *to, int glyph, int x, int y) {
   SDL_Rect dest = { x, y, 0, 0 };
-  SDL_BlitSurface(game->digits[d], NULL, game->screen, &dest);
+  SDL_BlitSurface(view->atlas, &view->glyphs[glyph], to, &dest);
 }
 
-void draw_number(int n, int x, int y) {
-  while (n != 0) {
-    draw_digit(n % 10, x, y);
+// n's last digit at x, the others to its left
+void draw_number(SDL_Surface *to, int n, int x, int y) {
+  do {
+    draw_glyph(to, n % 10, x, y);
     x -= 20;
     n /= 10;
+  } while (n != 0);
+}
+
+/*
+ * The panel is the cached layers put together; only the overlay, when it is
+ * on, is drawn glyph by glyph.
+ */
+void draw_right(Player *p) {
+  SDL_Rect pos = { p->x + WALL_WIDTH, p->y, 0, 0 };
+  hud_update(p);
+  SDL_BlitSurface(view->hud, NULL, view->screen, &pos);
+  pos.x = p->x + WALL_WIDTH + 20;
+  pos.y = p->y + 100;
+  SDL_BlitSurface(p->preview, NULL, view->screen, &pos);
+  pos.x = p->x + WALL_WIDTH + 42;
+  pos.y = p->y + 250;
+  SDL_BlitSurface(p->lines_field, NULL, view->screen, &pos);
+  pos.x = p->x + WALL_WIDTH + 42;
+  pos.y = p->y + 300;
+  SDL_BlitSurface(p->level_field, NULL, view->screen, &pos);
+  // frame times over the last second, in microseconds
+  if (view->overlay == 1) {
+    draw_text(view->screen, "P50", p->x + WALL_WIDTH + 20, p->y + 400);
+    draw_number(view->screen, view->overlay_us[0], p->x + 560, p->y + 400);
+    draw_text(view->screen, "P99", p->x + WALL_WIDTH + 20, p->y + 440);
+    draw_number(view->screen, view->overlay_us[1], p->x + 560, p->y + 440);
+    draw_text(view->screen, "MAX", p->x + WALL_WIDTH + 20, p->y + 480);
+    draw_number(view->screen, view->overlay_us[2], p->x + 560, p->y + 480);
   }
 }
 
-void draw_right() {
-  SDL_Rect pos = { WALL_WIDTH + 50, 100, 0, 0 };
-  SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  if (game->next->type == 0) {
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x -= BLOCK_SIZE;
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  else if (game->next->type == 1) {
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  else if (game->next->type == 2) {
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  else if (game->next->type == 3) {
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x -= BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  else if (game->next->type == 4) {
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x -= BLOCK_SIZE;
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x -= BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  else if (game->next->type == 5) {
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x -= BLOCK_SIZE;
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  else {
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.y += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-    pos.x += BLOCK_SIZE;
-    SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  }
-  lineRGBA(game->screen, WALL_WIDTH, 0, WALL_WIDTH, SCREEN_HEIGHT, 0, 178, 0, 255);
-  SDL_BlitSurface(game->next->img, NULL, game->screen, &pos);
-  pos.x = WALL_WIDTH + 20;
-  pos.y = 250;
-  SDL_BlitSurface(game->letters[LETTER_L], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_I], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_N], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_E], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_S], NULL, game->screen, &pos);
-  (game->lines == 0) ? draw_digit(0, 530, 250) : draw_number(game->lines, 530, 250);
-  pos.x = WALL_WIDTH + 20;
-  pos.y = 300;
-  SDL_BlitSurface(game->letters[LETTER_L], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_E], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_V], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_E], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_L], NULL, game->screen, &pos);
-  draw_number(game->level, 530, 300);
+// capitals, digits and spaces, 15 pixels apart
+void draw_text(SDL_Surface *to, const char *text, int x, int y) {
+  while (*text != '\0') {
+    if (*text >= '0' && *text <= '9')
+      draw_glyph(to, *text - '0', x, y);
+    else if (*text >= 'A' && *text <= 'Z')
+      draw_glyph(to, 10 + *text - 'A', x, y);
+    ++text;
+    x += 15;
+  }
 }
 
+/*
+ * An image from the bundle when there is one, used where it is mapped if
+ * the screen's pixels are laid out the same, or else decoded from images/.
+ */
 SDL_Surface *get_image(char *str) {
-  int size = strlen("images/") + strlen(str) + 1;
-  char *path = malloc(size * sizeof(char));
-  snprintf(path, size, "images/%s", str);
-  SDL_Surface *image = IMG_Load(path);
+  SDL_PixelFormat *format = view->screen->format;
+  SDL_Surface *image, *converted;
+  const Uint32 *pixels;
+  char path[64];
+  int w, h;
+  image = NULL;
+  if (view->bundled == 1 && (pixels = bundle_find(&view->bundle, str, &w, &h)) != NULL) {
+    image = SDL_CreateRGBSurfaceFrom((void *) pixels, w, h, 32, w * 4, 0xff0000, 0xff00, 0xff, 0);
+    if (image != NULL && format->BytesPerPixel == 4 && format->Rmask == 0xff0000 && format->Gmask == 0xff00 &&
+      format->Bmask == 0xff) {
+      ++view->surfaces;
+      view->bytes += image->pitch * image->h;
+      return image;
+    }
+  }
+  if (image == NULL) {
+    snprintf(path, sizeof(path), "images/%s", str);
+    image = IMG_Load(path);
+  }
   if (!image) {
     printf("IMG_Load: %s\n", IMG_GetError());
-    clean_up(1);
+    exit(clean_up(1));
   }
-  free(path);
-  return image;
+  // converting once here saves a format conversion on every blit
+  converted = SDL_DisplayFormat(image);
+  SDL_FreeSurface(image);
+  if (!converted) {
+    printf("SDL_DisplayFormat: %s\n", SDL_GetError());
+    exit(clean_up(1));
+  }
+  ++view->surfaces;
+  view->bytes += converted->pitch * converted->h;
+  return converted;
 }
 
-void empty_line(int y) {
-  if (++game->lines % 10 == 0)
-    ++game->level;
-  int x, yy, z;
-  x = 0;
-  while (x < WALL_WIDTH) {
-    game->grid[x][y] = NULL;
-    x += BLOCK_SIZE;
-  }
-  yy = y - BLOCK_SIZE;
-  while (yy > 0) {
-    x = 0;
-    while (x < WALL_WIDTH) {
-      if (game->grid[x][yy] != PTR_NULL) {
-        z = yy + BLOCK_SIZE;
-        while (game->grid[x][z] == PTR_NULL && z < WALL_HEIGHT) {
-	  game->grid[x][z] = game->grid[x][z - BLOCK_SIZE];
-	  game->grid[x][z - BLOCK_SIZE] = NULL;
-	  z += BLOCK_SIZE;
-	}
-      }
-      x += BLOCK_SIZE;
+void erase_area(SDL_Rect *area) {
+  SDL_FillRect(view->screen, area, SDL_MapRGB(view->screen->format, 0x00, 0x00, 0x00));
+}
+
+void free_image(SDL_Surface *image) {
+  --view->surfaces;
+  view->bytes -= image->pitch * image->h;
+  SDL_FreeSurface(image);
+}
+void game_over(Player *p) {
+  draw_text(view->screen, "GAME OVER", p->x + WALL_WIDTH / 2 - 75, p->y + WALL_HEIGHT / 2);
+}
+
+void game_pause(Player *p) {
+  draw_text(view->screen, "PAUSED", p->x + WALL_WIDTH / 2 - 45, p->y + WALL_HEIGHT / 2);
+}
+
+// composes the panel's fixed parts, which every game shares
+void hud_new() {
+  view->hud = new_surface(PANEL_WIDTH, SCREEN_HEIGHT);
+  SDL_FillRect(view->hud, NULL, SDL_MapRGB(view->hud->format, 0x00, 0x00, 0x00));
+  lineRGBA(view->hud, 0, 0, 0, SCREEN_HEIGHT, 0, 178, 0, 255);
+  draw_text(view->hud, "LINES", 20, 250);
+  draw_text(view->hud, "LEVEL", 20, 300);
+}
+
+// draws again the fields whose values changed since they were last drawn
+void hud_update(Player *p) {
+  const Game *game = p->shown;
+  Shape next;
+  Cell squares[4];
+  SDL_Rect pos = { 0, 0, 0, 0 };
+  int i;
+  if (game->queue[0] != p->hud_next) {
+    SDL_FillRect(p->preview, NULL, SDL_MapRGB(p->preview->format, 0x00, 0x00, 0x00));
+    // the next shape as it will spawn, moved from the top of the wall to the panel
+    shape_spawn(&next, game->queue[0]);
+    shape_cells(&next, squares);
+    i = 0;
+    while (i < 4) {
+      pos.x = squares[i].x + 30 - BOARD_WIDTH / 2 * BLOCK_SIZE;
+      pos.y = squares[i].y;
+      SDL_BlitSurface(view->tiles[next.type], NULL, p->preview, &pos);
+      ++i;
     }
-    yy -= BLOCK_SIZE;
+    p->hud_next = game->queue[0];
+  }
+  if (game->lines != p->hud_lines) {
+    SDL_FillRect(p->lines_field, NULL, SDL_MapRGB(p->lines_field->format, 0x00, 0x00, 0x00));
+    draw_number(p->lines_field, game->lines, 88, 0);
+    p->hud_lines = game->lines;
+  }
+  if (game->level != p->hud_level) {
+    SDL_FillRect(p->level_field, NULL, SDL_MapRGB(p->level_field->format, 0x00, 0x00, 0x00));
+    draw_number(p->level_field, game->level, 88, 0);
+    p->hud_level = game->level;
   }
 }
 
-void erase_screen() {
-  SDL_Rect rect = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
-  SDL_FillRect(game->screen, &rect, SDL_MapRGB(game->screen->format, 0x00, 0x00, 0x00));
+// a blank surface in the screen's format, counted with the images
+SDL_Surface *new_surface(int w, int h) {
+  SDL_PixelFormat *format = view->screen->format;
+  SDL_Surface *surface;
+  surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, format->BitsPerPixel, format->Rmask, format->Gmask,
+    format->Bmask, format->Amask);
+  if (!surface) {
+    printf("SDL_CreateRGBSurface: %s\n", SDL_GetError());
+    exit(clean_up(1));
+  }
+  if (format->palette != NULL)
+    SDL_SetColors(surface, format->palette->colors, 0, format->palette->ncolors);
+  ++view->surfaces;
+  view->bytes += surface->pitch * surface->h;
+  return surface;
 }
-void falling_next() {
-  game->falling->pos[0] = game->next->pos[0];
-  game->falling->pos[1] = game->next->pos[1];
-  game->falling->pos[2] = game->next->pos[2];
-  game->falling->pos[3] = game->next->pos[3];
-  game->falling->img = game->next->img;
-  game->falling->angle = game->next->angle;
-  game->falling->type = game->next->type;
-  shape_new();
+
+// a monotonic clock, in nanoseconds
+Uint64 now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (Uint64) t.tv_sec * 1000000000 + t.tv_nsec;
 }
-int flip_checking(SDL_Rect pos[]) {
-  int max_width, max_height, y, ok;
-  max_width = WALL_WIDTH - BLOCK_SIZE;
-  max_height = WALL_HEIGHT - BLOCK_SIZE;
-  y = 0;
-  ok = 1;
-  while (y < BLOCK_SIZE) {
-    if (game->grid[pos[0].x][pos[0].y + y] != PTR_NULL ||
-      game->grid[pos[1].x][pos[1].y + y] != PTR_NULL ||
-      game->grid[pos[2].x][pos[2].y + y] != PTR_NULL ||
-      game->grid[pos[3].x][pos[3].y + y] != PTR_NULL)
-      ok = 0;
-    y += FALL_STEP;
-  }
-  if (pos[0].x >= 0 && pos[0].x <= max_width && pos[0].y >= 0 && pos[0].y <= max_height &&
-    pos[1].x >= 0 && pos[1].x <= max_width && pos[1].y >= 0 && pos[1].y <= max_height &&
-    pos[2].x >= 0 && pos[2].x <= max_width && pos[2].y >= 0 && pos[2].y <= max_height &&
-    pos[3].x >= 0 && pos[3].x <= max_width && pos[3].y >= 0 && pos[3].y <= max_height &&
-    ok == 1)
-    return 1;
-  return 0;
+
+void player_free(Player *p) {
+  free_image(p->preview);
+  free_image(p->lines_field);
+  free_image(p->level_field);
 }
 
-void game_new() {
-  int x, y;
-  char *str = malloc(6 * sizeof(char));
-  // initializing the full grid as empty squares
-  x = 0;
-  while (x < WALL_WIDTH) {
+// a game and its panel fields, drawn into the viewport whose corner is at x, y
+void player_new(Player *p, Uint64 seed, int randomizer, int x, int y) {
+  p->seed = seed;
+  p->randomizer = randomizer;
+  p->x = x;
+  p->y = y;
+  game_new(&p->game, seed, randomizer);
+  p->preview = new_surface(160, 4 * BLOCK_SIZE);
+  p->lines_field = new_surface(100, GLYPH_HEIGHT);
+  p->level_field = new_surface(100, GLYPH_HEIGHT);
+  p->hud_lines = -1;
+  p->hud_level = -1;
+  p->hud_next = -1;
+  // nothing is on the screen yet, so the first frame redraws it all
+  p->drawn_mode = -1;
+  p->drawn_lines = -1;
+  p->shown = &p->game;
+  p->drawn_ghost = p->game.falling;
+}
+
+// steps a game one tick, with input from the keys, a replay or the AI
+void player_tick(Player *p, int input) {
+  // playback goes through the same step as live input, which it replaces
+  if (p->play != NULL)
+    input = (replay_done(p->play) == 1) ? 0 : replay_input(p->play);
+  else if (p->autoplay == 1)
+    input |= view_autoplay(p);
+  if (p->record != NULL)
+    replay_write(p->record, input);
+  game_step(&p->game, input);
+  // a bot soaking the build starts over, unless the game is being recorded
+  if (p->autoplay == 1 && p->game.over == 1 && p->record == NULL) {
+    fprintf(stderr, "game over: game %d, seed %llu, %d lines, %d pieces\n", (int) (p - view->players),
+      (unsigned long long) p->seed, p->game.lines, p->game.pieces);
+    // the next seed none of the other games will play
+    p->seed += view->count;
+    game_new(&p->game, p->seed, p->randomizer);
+    p->planned = 0;
+  }
+}
+
+/*
+ * Redraws everything inside area, a rect of p's viewport, clipped to it.
+ * mode tells what the wall shows: 0 the game, 1 the pause text, 2 the game
+ * over text.
+ */
+void redraw(Player *p, SDL_Rect *area, int mode) {
+  SDL_Rect clip = { p->x + area->x, p->y + area->y, area->w, area->h };
+  Frame frame;
+  Uint64 t = now();
+  SDL_SetClipRect(view->screen, &clip);
+  erase_area(&clip);
+  t = view_phase(PHASE_ERASE, t);
+  if (area->x < WALL_WIDTH) {
+    if (mode == 1)
+      game_pause(p);
+    else if (mode == 2)
+      game_over(p);
+    else {
+      // the wall's squares are copied straight into the screen's pixels
+      frame.pitch = view->screen->pitch / 4;
+      frame.pixels = (Uint32 *) view->screen->pixels + clip.y * frame.pitch + clip.x;
+      frame.x = area->x;
+      frame.y = area->y;
+      frame.w = area->w;
+      frame.h = area->h;
+      if (SDL_MUSTLOCK(view->screen))
+        SDL_LockSurface(view->screen);
+      blit_board(&frame, &p->shown->board, view->tile_pixels);
+      t = view_phase(PHASE_BLOCKS, t);
+      shape_draw(p, &frame);
+      if (SDL_MUSTLOCK(view->screen))
+        SDL_UnlockSurface(view->screen);
+    }
+    t = view_phase(PHASE_SHAPE, t);
+  }
+  if (area->x + area->w > WALL_WIDTH) {
+    draw_right(p);
+    view_phase(PHASE_RIGHT, t);
+  }
+  SDL_SetClipRect(view->screen, NULL);
+}
+
+/*
+ * Only the parts of the viewport that changed since the last frame are
+ * redrawn and pushed: the falling shape's old and new squares, the board
+ * rows that differ from what was drawn (locks and cleared lines), and the
+ * right panel when its numbers or the next shape change.
+ */
+void render(Player *p) {
+  const Game *game = p->shown;
+  Shape ghost;
+  Uint64 t;
+  int i, y, mode;
+  mode = (game->paused == 1) ? 1 : (game->over == 1) ? 2 : 0;
+  p->ndirty = 0;
+  if (mode != p->drawn_mode)
+    damage(p, 0, 0, WALL_WIDTH, WALL_HEIGHT);
+  else if (mode == 0) {
     y = 0;
-    while (y < WALL_HEIGHT) {
-      game->grid[x][y] = NULL;
-      y += FALL_STEP;
+    while (y < BOARD_HEIGHT) {
+      if (memcmp(p->drawn_cells[y], game->board.cells[y], sizeof(p->drawn_cells[0])) != 0)
+        damage(p, 0, y * BLOCK_SIZE, WALL_WIDTH, BLOCK_SIZE);
+      ++y;
     }
-    x += BLOCK_SIZE;
-  }
-  x = 0;
-  while (x < 10) {
-    snprintf(str, 6, "%d.jpg", x);
-    game->digits[x++] = get_image(str);
-  }
-  free(str);
-  game->letters[LETTER_A] = get_image("A.jpg");
-  game->letters[LETTER_B] = get_image("B.jpg");
-  game->letters[LETTER_C] = get_image("C.jpg");
-  game->letters[LETTER_D] = get_image("D.jpg");
-  game->letters[LETTER_E] = get_image("E.jpg");
-  game->letters[LETTER_F] = get_image("F.jpg");
-  game->letters[LETTER_G] = get_image("G.jpg");
-  game->letters[LETTER_H] = get_image("H.jpg");
-  game->letters[LETTER_I] = get_image("I.jpg");
-  game->letters[LETTER_J] = get_image("J.jpg");
-  game->letters[LETTER_K] = get_image("K.jpg");
-  game->letters[LETTER_L] = get_image("L.jpg");
-  game->letters[LETTER_M] = get_image("M.jpg");
-  game->letters[LETTER_N] = get_image("N.jpg");
-  game->letters[LETTER_O] = get_image("O.jpg");
-  game->letters[LETTER_P] = get_image("P.jpg");
-  game->letters[LETTER_Q] = get_image("Q.jpg");
-  game->letters[LETTER_R] = get_image("R.jpg");
-  game->letters[LETTER_S] = get_image("S.jpg");
-  game->letters[LETTER_T] = get_image("T.jpg");
-  game->letters[LETTER_U] = get_image("U.jpg");
-  game->letters[LETTER_V] = get_image("V.jpg");
-  game->letters[LETTER_W] = get_image("W.jpg");
-  game->letters[LETTER_X] = get_image("X.jpg");
-  game->letters[LETTER_Y] = get_image("Y.jpg");
-  game->letters[LETTER_Z] = get_image("Z.jpg");
-  game->level = 1;
-  game->lines = 0;
-  game->over = 0;
-  game->paused = 0;
-  game->running = 1;
-  game->delay = SPEED;
-  game->next = malloc(sizeof(struct Shape));
-  shape_new();
-  game->falling = malloc(sizeof(struct Shape));
-  falling_next();
-}
-
-void game_over() {
-  SDL_Rect pos = { (int) WALL_WIDTH / 2 - 75, (int) WALL_HEIGHT / 2, 0, 0 };
-  SDL_BlitSurface(game->letters[LETTER_G], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_A], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_M], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_E], NULL, game->screen, &pos);
-  pos.x += 30;
-  SDL_BlitSurface(game->letters[LETTER_O], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_V], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_E], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_R], NULL, game->screen, &pos);
-}
-
-void game_pause() {
-  SDL_Rect pos = { (int) WALL_WIDTH / 2 - 45, (int) WALL_HEIGHT / 2, 0, 0 };
-  SDL_BlitSurface(game->letters[LETTER_P], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_A], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_U], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_S], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_E], NULL, game->screen, &pos);
-  pos.x += 15;
-  SDL_BlitSurface(game->letters[LETTER_D], NULL, game->screen, &pos);
-}
-
-int min(int y1, int y2, int y3, int y4) {
-   int min1, min2;
-   min1 = (y1 < y2) ? y1 : y2;
-   min2 = (y3 < y4) ? y3 : y4;
-   return (min1 < min2) ? min1 : min2;
-}
-void move_left() {
-  int ok, y;
-  y = 0;
-  ok = 1;
-  while (y < BLOCK_SIZE) {
-    if (game->grid[game->falling->pos[0].x - BLOCK_SIZE][game->falling->pos[0].y + y] != PTR_NULL ||
-      game->grid[game->falling->pos[1].x - BLOCK_SIZE][game->falling->pos[1].y + y] != PTR_NULL ||
-      game->grid[game->falling->pos[2].x - BLOCK_SIZE][game->falling->pos[2].y + y] != PTR_NULL ||
-      game->grid[game->falling->pos[3].x - BLOCK_SIZE][game->falling->pos[3].y + y] != PTR_NULL)
-      ok = 0;
-    y += FALL_STEP;
-  }
-  if (game->falling->pos[0].x >= BLOCK_SIZE && game->falling->pos[1].x >= BLOCK_SIZE && game->falling->pos[2].x >= BLOCK_SIZE && game->falling->pos[3].x >= BLOCK_SIZE && ok == 1) {
-    game->falling->pos[0].x -= BLOCK_SIZE;
-    game->falling->pos[1].x -= BLOCK_SIZE;
-    game->falling->pos[2].x -= BLOCK_SIZE;
-    game->falling->pos[3].x -= BLOCK_SIZE;
-  }
-}
-
-void move_right() {
-  int ok, y, max;
-  max = WALL_WIDTH - BLOCK_SIZE;
-  y = 0;
-  ok = 1;
-  while (y < BLOCK_SIZE) {
-    if (game->grid[game->falling->pos[0].x + BLOCK_SIZE][game->falling->pos[0].y + y] != PTR_NULL ||
-      game->grid[game->falling->pos[1].x + BLOCK_SIZE][game->falling->pos[1].y + y] != PTR_NULL ||
-      game->grid[game->falling->pos[2].x + BLOCK_SIZE][game->falling->pos[2].y + y] != PTR_NULL ||
-      game->grid[game->falling->pos[3].x + BLOCK_SIZE][game->falling->pos[3].y + y] != PTR_NULL)
-      ok = 0;
-    y += FALL_STEP;
-  }
-  if (game->falling->pos[0].x < max && game->falling->pos[1].x < max && game->falling->pos[2].x < max && game->falling->pos[3].x < max && ok == 1) {
-    game->falling->pos[0].x += BLOCK_SIZE;
-    game->falling->pos[1].x += BLOCK_SIZE;
-    game->falling->pos[2].x += BLOCK_SIZE;
-    game->falling->pos[3].x += BLOCK_SIZE;
-  }
-}
-
-void shape_draw() {
-  SDL_BlitSurface(game->falling->img, NULL, game->screen, &game->falling->pos[0]);
-  SDL_BlitSurface(game->falling->img, NULL, game->screen, &game->falling->pos[1]);
-  SDL_BlitSurface(game->falling->img, NULL, game->screen, &game->falling->pos[2]);
-  SDL_BlitSurface(game->falling->img, NULL, game->screen, &game->falling->pos[3]);
-}
-
-void shape_fall() {
-  int max = WALL_HEIGHT - BLOCK_SIZE;
-  if (game->falling->pos[0].y < max && game->falling->pos[1].y < max && game->falling->pos[2].y < max && game->falling->pos[3].y < max &&
-    game->grid[game->falling->pos[0].x][game->falling->pos[0].y + BLOCK_SIZE] == PTR_NULL &&
-    game->grid[game->falling->pos[1].x][game->falling->pos[1].y + BLOCK_SIZE] == PTR_NULL &&
-    game->grid[game->falling->pos[2].x][game->falling->pos[2].y + BLOCK_SIZE] == PTR_NULL &&
-    game->grid[game->falling->pos[3].x][game->falling->pos[3].y + BLOCK_SIZE] == PTR_NULL) {
-    game->falling->pos[0].y += FALL_STEP;
-    game->falling->pos[1].y += FALL_STEP;
-    game->falling->pos[2].y += FALL_STEP;
-    game->falling->pos[3].y += FALL_STEP;
-  }
-  else { // stuck, let's fall a new shape
-    game->grid[game->falling->pos[0].x][game->falling->pos[0].y] = game->falling->img;
-    game->grid[game->falling->pos[1].x][game->falling->pos[1].y] = game->falling->img;
-    game->grid[game->falling->pos[2].x][game->falling->pos[2].y] = game->falling->img;
-    game->grid[game->falling->pos[3].x][game->falling->pos[3].y] = game->falling->img;
-    check_lines(min(game->falling->pos[0].y, game->falling->pos[1].y, game->falling->pos[2].y, game->falling->pos[3].y));
-    falling_next();
-  }
-}
-void shape_new() {
-  SDL_Rect pos = { (int) (WALL_WIDTH / 2), 0, 0, 0 };
-  game->next->angle = 0;
-  srand(time(NULL));
-  game->next->type = (int) (7.0 * rand() / (RAND_MAX + 1.0));
-  game->next->pos[0] = pos;
-  if (game->next->type == 0) { // g.jpg
-    game->next->img = get_image("g.jpg");
-    pos.x += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.x -= BLOCK_SIZE;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-  else if (game->next->type == 1) { // i.jpg
-    game->next->img = get_image("i.jpg");
-    pos.y += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-  else if (game->next->type == 2) { // l.jpg
-    game->next->img = get_image("l.jpg");
-    pos.y += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.x += BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-  else if (game->next->type == 3) { // o.jpg
-    game->next->img = get_image("o.jpg");
-    pos.x += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.x -= BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-  else if (game->next->type == 4) { // s.jpg
-    game->next->img = get_image("s.jpg");
-    pos.x += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.x -= BLOCK_SIZE;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.x -= BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-  else if (game->next->type == 5) { // t.jpg
-    game->next->img = get_image("t.jpg");
-    pos.x += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.x += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.x -= BLOCK_SIZE;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-  else { // z.jpg
-    game->next->img = get_image("z.jpg");
-    pos.x += BLOCK_SIZE;
-    game->next->pos[1] = pos;
-    pos.y += BLOCK_SIZE;
-    game->next->pos[2] = pos;
-    pos.x += BLOCK_SIZE;
-    game->next->pos[3] = pos;
-  }
-}
-
-void shape_flip(int clockwise) {
-  SDL_Rect pos[4];
-  pos[0] = game->falling->pos[0];
-  pos[1] = game->falling->pos[1];
-  pos[2] = game->falling->pos[2];
-  pos[3] = game->falling->pos[3];
-  if (game->falling->type == 0) { // g.jpg
-    if (game->falling->angle == 0)
-      if (clockwise == 0) {
-        pos[0].x += BLOCK_SIZE;
-	pos[0].y += 2 * BLOCK_SIZE;
-	pos[1].x += BLOCK_SIZE;
-	pos[1].y += 2 * BLOCK_SIZE;
-      }
-      else {
-        pos[2].x += 2 * BLOCK_SIZE;
-	pos[2].y -= BLOCK_SIZE;
-	pos[3].x += 2 * BLOCK_SIZE;
-	pos[3].y -= BLOCK_SIZE;
-      }
-    else if (game->falling->angle == 1)
-      if (clockwise == 0) {
-        pos[2].x -= 2 * BLOCK_SIZE;
-	pos[2].y += BLOCK_SIZE;
-	pos[3].x -= 2 * BLOCK_SIZE;
-	pos[3].y += BLOCK_SIZE;
-      }
-      else {
-        pos[0].x += BLOCK_SIZE;
-	pos[0].y += 2 * BLOCK_SIZE;
-	pos[1].x += BLOCK_SIZE;
-	pos[1].y += 2 * BLOCK_SIZE;
-      }
-    else if (game->falling->angle == 2)
-      if (clockwise == 0) {
-        pos[0].x -= BLOCK_SIZE;
-	pos[0].y -= 2 * BLOCK_SIZE;
-	pos[1].x -= BLOCK_SIZE;
-	pos[1].y -= 2 * BLOCK_SIZE;
-      }
-      else {
-        pos[2].x -= 2 * BLOCK_SIZE;
-	pos[2].y += BLOCK_SIZE;
-	pos[3].x -= 2 * BLOCK_SIZE;
-	pos[3].y += BLOCK_SIZE;
-      }
-    else
-      if (clockwise == 0) {
-        pos[2].x += 2 * BLOCK_SIZE;
-	pos[2].y -= BLOCK_SIZE;
-	pos[3].x += 2 * BLOCK_SIZE;
-	pos[3].y -= BLOCK_SIZE;
-      }
-      else {
-        pos[0].x -= BLOCK_SIZE;
-	pos[0].y -= 2 * BLOCK_SIZE;
-	pos[1].x -= BLOCK_SIZE;
-	pos[1].y -= 2 * BLOCK_SIZE;
-      }
+    if (memcmp(&p->drawn_falling, &game->falling, sizeof(Shape)) != 0)
+      damage_shape(p, &p->drawn_falling, &game->falling);
+  }
+  if (mode == 0) { // where the shape would land, which shape_draw() shows under it
+    ghost = game->falling;
+    ghost.y = shape_landing(game);
+    if (p->drawn_mode == 0 && memcmp(&p->drawn_ghost, &ghost, sizeof(Shape)) != 0)
+      damage_shape(p, &p->drawn_ghost, &ghost);
+    p->drawn_ghost = ghost;
+  }
+  if (game->lines != p->drawn_lines || game->level != p->drawn_level || game->queue[0] != p->drawn_next ||
+    view->overlay != p->drawn_overlay ||
+    (view->overlay == 1 && memcmp(view->overlay_us, p->drawn_overlay_us, sizeof(view->overlay_us)) != 0))
+    damage(p, WALL_WIDTH, 0, SCREEN_WIDTH - WALL_WIDTH, SCREEN_HEIGHT);
+  i = 0;
+  while (i < p->ndirty) {
+    redraw(p, &p->dirty[i], mode);
+    // pushed in screen coordinates
+    p->dirty[i].x += p->x;
+    p->dirty[i].y += p->y;
+    ++i;
+  }
+  t = now();
+  SDL_UpdateRects(view->screen, p->ndirty, p->dirty);
+  view_phase(PHASE_UPDATE, t);
+  p->drawn_mode = mode;
+  p->drawn_lines = game->lines;
+  p->drawn_level = game->level;
+  p->drawn_next = game->queue[0];
+  p->drawn_overlay = view->overlay;
+  memcpy(p->drawn_overlay_us, view->overlay_us, sizeof(view->overlay_us));
+  memcpy(p->drawn_cells, game->board.cells, sizeof(p->drawn_cells));
+  p->drawn_falling = game->falling;
+}
+
+void shape_draw(Player *p, const Frame *frame) {
+  Cell squares[4];
+  int i = 0;
+  shape_cells(&p->drawn_ghost, squares);
+  while (i < 4) {
+    blit_tile(frame, squares[i].x, squares[i].y, view->ghost_pixels[p->drawn_ghost.type]);
+    ++i;
+  }
+  i = 0;
+  shape_cells(&p->shown->falling, squares);
+  while (i < 4) {
+    blit_tile(frame, squares[i].x, squares[i].y, view->tile_pixels[p->shown->falling.type]);
+    ++i;
   }
-  else if (game->falling->type == 1) // i.jpg
-    if (game->falling->angle == 0) {
-      pos[0].x -= BLOCK_SIZE;
-      pos[0].y += BLOCK_SIZE;
-      pos[2].x += BLOCK_SIZE;
-      pos[2].y -= BLOCK_SIZE;
-      pos[3].x += 2 * BLOCK_SIZE;
-      pos[3].y -= 2 * BLOCK_SIZE;
+}
+
+// a tile image's pixels, in the screen's format, cut or padded to a square
+void tile_copy(SDL_Surface *image, Uint32 pixels[TILE_PIXELS]) {
+  int x, y;
+  memset(pixels, 0, TILE_PIXELS * sizeof(Uint32));
+  if (SDL_MUSTLOCK(image))
+    SDL_LockSurface(image);
+  y = 0;
+  while (y < BLOCK_SIZE && y < image->h) {
+    x = 0;
+    while (x < BLOCK_SIZE && x < image->w) {
+      pixels[y * BLOCK_SIZE + x] = ((Uint32 *) ((Uint8 *) image->pixels + y * image->pitch))[x];
+      ++x;
     }
-    else {
-      pos[0].x += BLOCK_SIZE;
-      pos[0].y -= BLOCK_SIZE;
-      pos[2].x -= BLOCK_SIZE;
-      pos[2].y += BLOCK_SIZE;
-      pos[3].x -= 2 * BLOCK_SIZE;
-      pos[3].y += 2 * BLOCK_SIZE;
+    ++y;
+  }
+  if (SDL_MUSTLOCK(image))
+    SDL_UnlockSurface(image);
+}
+
+/*
+ * The input that moves the falling shape one step toward where the AI wants
+ * it. The search runs once per piece, when it spawns, and is timed.
+ */
+int view_autoplay(Player *p) {
+  Uint64 start;
+  if (p->game.over == 1 || p->game.paused == 1)
+    return 0;
+  if (p->planned != p->game.pieces) {
+    start = now();
+    view->evaluated += ai_search(&p->game, &ai_weights, &p->target);
+    view->search_ns += now() - start;
+    ++view->searches;
+    p->planned = p->game.pieces;
+  }
+  return ai_input(&p->game, &p->target);
+}
+
+/*
+ * Draws full frames of a game the AI has played for a while into an
+ * offscreen copy of the screen, and prints the time per frame as a line of
+ * JSON, like the benchmark program. Surfaces loaded while drawing stand
+ * for its allocations, and there should be none.
+ */
+void view_bench(int frames) {
+  SDL_Surface *screen = view->screen;
+  SDL_Rect all = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+  Uint64 start, ns;
+  int i, surfaces;
+  view->screen = SDL_ConvertSurface(screen, screen->format, SDL_SWSURFACE);
+  if (view->screen == NULL) {
+    fprintf(stderr, "SDL_ConvertSurface: %s\n", SDL_GetError());
+    view->screen = screen;
+    return;
+  }
+  i = 0;
+  while (i < view->count) {
+    ai_play(&view->players[i].game, &ai_weights, 60);
+    view->players[i].drawn_ghost = view->players[i].game.falling;
+    view->players[i].drawn_ghost.y = shape_landing(&view->players[i].game);
+    ++i;
+  }
+  surfaces = view->surfaces;
+  start = now();
+  i = 0;
+  while (i < frames)
+    redraw(&view->players[i++ % view->count], &all, 0);
+  ns = now() - start;
+  printf("{\"name\": \"render_frame\", \"ops\": %d, \"ns_per_op\": %.2f, \"allocs_per_op\": %g, "
+    "\"frames_per_s\": %.0f}\n", frames, (double) ns / frames, (double) (view->surfaces - surfaces) / frames,
+    frames * 1e9 / ns);
+  SDL_FreeSurface(view->screen);
+  view->screen = screen;
+}
+
+// queues the screen as the frame for the current tick
+void view_capture(long ticks, int wait) {
+  if (SDL_MUSTLOCK(view->screen))
+    SDL_LockSurface(view->screen);
+  capture_push(view->capture, view->screen->pixels, view->screen->pitch / 4, wait);
+  if (SDL_MUSTLOCK(view->screen))
+    SDL_UnlockSurface(view->screen);
+  view->captured = ticks / CAPTURE_TICKS;
+}
+
+/*
+ * Plays the replay back as fast as frames are drawn and written, a frame
+ * every CAPTURE_TICKS ticks. The drawing is the same as on screen, into the
+ * offscreen surface the dummy video driver gives, and only waits for the
+ * writer when the ring is full.
+ */
+void view_export() {
+  Player *p = &view->players[0];
+  Uint64 start = now();
+  double seconds;
+  int i;
+  while (replay_done(p->play) == 0) {
+    i = 0;
+    while (i < view->count)
+      player_tick(&view->players[i++], 0);
+    if (++view->ticks % CAPTURE_TICKS == 0) {
+      i = 0;
+      while (i < view->count)
+        render(&view->players[i++]);
+      view_capture(view->ticks, 1);
     }
-  else if (game->falling->type == 2) { // l.jpg
-    if (game->falling->angle == 0)
-      if (clockwise == 0) {
-        pos[0].x += 2 * BLOCK_SIZE;
-	pos[0].y += BLOCK_SIZE;
-	pos[1].x += 2 * BLOCK_SIZE;
-	pos[1].y += BLOCK_SIZE;
-      }
-      else {
-        pos[2].x += BLOCK_SIZE;
-	pos[2].y -= 2 * BLOCK_SIZE;
-	pos[3].x += BLOCK_SIZE;
-	pos[3].y -= 2 * BLOCK_SIZE;
-      }
-    else if (game->falling->angle == 1)
-      if (clockwise == 0) {
-        pos[2].x -= BLOCK_SIZE;
-	pos[2].y += 2 * BLOCK_SIZE;
-	pos[3].x -= BLOCK_SIZE;
-	pos[3].y += 2 * BLOCK_SIZE;
-      }
-      else {
-        pos[0].x += 2 * BLOCK_SIZE;
-	pos[0].y += BLOCK_SIZE;
-	pos[1].x += 2 * BLOCK_SIZE;
-	pos[1].y += BLOCK_SIZE;
-      }
-    else if (game->falling->angle == 2)
-      if (clockwise == 0) {
-        pos[0].x -= 2 * BLOCK_SIZE;
-	pos[0].y -= BLOCK_SIZE;
-	pos[1].x -= 2 * BLOCK_SIZE;
-	pos[1].y -= BLOCK_SIZE;
-      }
-      else {
-        pos[2].x -= BLOCK_SIZE;
-	pos[2].y += 2 * BLOCK_SIZE;
-        pos[3].x -= BLOCK_SIZE;
-	pos[3].y += 2 * BLOCK_SIZE;
-      }
-    else
-      if (clockwise == 0) {
-        pos[2].x += BLOCK_SIZE;
-	pos[2].y -= 2 * BLOCK_SIZE;
-	pos[3].x += BLOCK_SIZE;
-	pos[3].y -= 2 * BLOCK_SIZE;
+  }
+  capture_close(view->capture);
+  seconds = (now() - start) / 1e9;
+  fprintf(stderr, "%ld frames for %.0f s of play in %.1f s\n", view->capture->written,
+    (double) view->ticks / TICK_RATE, seconds);
+}
+
+void view_free() {
+  int i = 0;
+  while (i < view->count)
+    player_free(&view->players[i++]);
+  i = 0;
+  while (i < 7)
+    free_image(view->tiles[i++]);
+  free_image(view->atlas);
+  free_image(view->hud);
+  // the tiles were the last surfaces on the mapping
+  if (view->bundled == 1)
+    bundle_close(&view->bundle);
+}
+
+/*
+ * Every image the game draws is decoded and converted here, once; spawning
+ * and drawing only blit from these surfaces afterwards.
+ */
+void view_new(const char *font) {
+  int i;
+  view->surfaces = 0;
+  view->bytes = 0;
+  view->bundled = (bundle_open(&view->bundle, BUNDLE_PATH) == 0);
+  atlas_new(font);
+  view->tiles[0] = get_image("g.jpg");
+  view->tiles[1] = get_image("i.jpg");
+  view->tiles[2] = get_image("l.jpg");
+  view->tiles[3] = get_image("o.jpg");
+  view->tiles[4] = get_image("s.jpg");
+  view->tiles[5] = get_image("t.jpg");
+  view->tiles[6] = get_image("z.jpg");
+  i = 0;
+  while (i < 7) {
+    tile_copy(view->tiles[i], view->tile_pixels[i]);
+    ++i;
+  }
+  // a quarter of each channel, the way the ghost shape is shaded
+  i = 0;
+  while (i < 7 * TILE_PIXELS) {
+    view->ghost_pixels[i / TILE_PIXELS][i % TILE_PIXELS] = (view->tile_pixels[i / TILE_PIXELS][i % TILE_PIXELS] >> 2) & 0x3f3f3f3f;
+    ++i;
+  }
+  hud_new();
+  view->running = 1;
+}
+
+// adds the time since since to a phase of the frame, and returns the time now
+Uint64 view_phase(int phase, Uint64 since) {
+  Uint64 t = now();
+  view->phase_ns[phase] += t - since;
+  return t;
+}
+
+// copies every game into a snapshot and hands it over to the drawing
+void view_publish() {
+  Snapshot *snapshot = triple_back(&view->snapshots);
+  int i = 0;
+  snapshot->ticks = view->ticks;
+  snapshot->jitter_us = view->jitter_us;
+  snapshot->ai_rate = view->ai_rate;
+  snapshot->ai_us = view->ai_us;
+  while (i < view->count) {
+    snapshot->games[i] = view->players[i].game;
+    ++i;
+  }
+  triple_publish(&view->snapshots);
+}
+
+/*
+ * The simulation thread: every tick that is due runs, at TICK_RATE per
+ * second whatever the drawing costs, and publishes a snapshot, then the
+ * thread sleeps until the next tick. It never waits on the drawing, nor the
+ * drawing on it. Each tick's time goes to the tick histogram.
+ */
+void *view_simulate(void *unused) {
+  Uint64 t, next_tick, start;
+  struct timespec wait;
+  int i, input;
+  next_tick = now();
+  view->tick_second = next_tick;
+  while (view->running == 1) {
+    t = now();
+    if (t - next_tick > MAX_CATCH_UP)
+      next_tick = t - MAX_CATCH_UP;
+    while (next_tick <= t) {
+      if (t - next_tick > view->jitter_max)
+        view->jitter_max = t - next_tick;
+      start = now();
+      input = input_tick(&view->keys, start);
+      i = 0;
+      while (i < view->count) {
+        player_tick(&view->players[i], (i == 0) ? input : 0);
+        ++i;
       }
-      else {
-        pos[0].x -= 2 * BLOCK_SIZE;
-	pos[0].y -= BLOCK_SIZE;
-	pos[1].x -= 2 * BLOCK_SIZE;
-	pos[1].y -= BLOCK_SIZE;
+      ++view->ticks;
+      histogram_add(&view->phases[PHASE_STEP], now() - start);
+      view_publish();
+      next_tick += TICK_NS;
+    }
+    if (t - view->tick_second >= 1000000000) {
+      view->jitter_us = view->jitter_max / 1000;
+      if (view->searches > 0) {
+        view->ai_rate = (view->search_ns > 0) ? view->evaluated * 1000000000LL / view->search_ns : 0;
+        view->ai_us = view->search_ns / view->searches / 1000;
       }
-  }
-  else if (game->falling->type == 3) // o.jpg -- nothing to do
-    ;
-  else if (game->falling->type == 4) // s.jpg
-    if (game->falling->angle == 0) {
-      pos[2].y -= 2 * BLOCK_SIZE;
-      pos[3].x += 2 * BLOCK_SIZE;
+      view->evaluated = 0;
+      view->searches = 0;
+      view->search_ns = 0;
+      view->jitter_max = 0;
+      view->tick_second = t;
     }
-    else {
-      pos[2].y += 2 * BLOCK_SIZE;
-      pos[3].x -= 2 * BLOCK_SIZE;
+    t = now();
+    if (next_tick > t) {
+      wait.tv_sec = (next_tick - t) / 1000000000;
+      wait.tv_nsec = (next_tick - t) % 1000000000;
+      nanosleep(&wait, NULL);
     }
-  else if (game->falling->type == 5) { // t.jpg
-    if (game->falling->angle == 0)
-      if (clockwise == 0) {
-        pos[0].x += BLOCK_SIZE;
-	pos[0].y -= BLOCK_SIZE;
-      }
-      else {
-        pos[2].x -= BLOCK_SIZE;
-	pos[2].y -= BLOCK_SIZE;
-      }
-    else if (game->falling->angle == 1)
-      if (clockwise == 0) {
-        pos[2].x += BLOCK_SIZE;
-	pos[2].y += BLOCK_SIZE;
-      }
-      else {
-        pos[3].x += BLOCK_SIZE;
-	pos[3].y -= BLOCK_SIZE;
-      }
-    else if (game->falling->angle == 2)
-      if (clockwise == 0) {
-        pos[3].x -= BLOCK_SIZE;
-	pos[3].y += BLOCK_SIZE;
-      }
-      else {
-        pos[0].x += BLOCK_SIZE;
-	pos[0].y -= BLOCK_SIZE;
-	pos[2].x += BLOCK_SIZE;
-	pos[2].y += BLOCK_SIZE;
-	pos[3].x -= BLOCK_SIZE;
-	pos[3].y += BLOCK_SIZE;
-      }
-    else
-      if (clockwise == 0) {
-        pos[0].x -= BLOCK_SIZE;
-	pos[0].y += BLOCK_SIZE;
-	pos[2].x -= BLOCK_SIZE;
-	pos[2].y -= BLOCK_SIZE;
-	pos[3].x += BLOCK_SIZE;
-	pos[3].y -= BLOCK_SIZE;
-      }
-      else {
-        pos[0].x -= BLOCK_SIZE;
-	pos[0].y += BLOCK_SIZE;
-      }
   }
-  else // z.jpg
-    if (game->falling->angle == 0) {
-      pos[2].x -= BLOCK_SIZE;
-      pos[3].x -= BLOCK_SIZE;
-      pos[3].y -= 2 * BLOCK_SIZE;
-    }
-    else {
-      pos[2].x += BLOCK_SIZE;
-      pos[3].x += BLOCK_SIZE;
-      pos[3].y += 2 * BLOCK_SIZE;
+  return NULL;
+}
+
+// shows the image counters and timings in the window title when they change
+void view_stats() {
+  static int surfaces = -1, fps = -1, frame_us = -1, frame_max_us = -1, jitter_us = -1, ai_us = -1;
+  static long bytes = -1, ai_rate = -1;
+  char caption[192];
+  int n;
+  if (view->surfaces == surfaces && view->bytes == bytes && view->fps == fps && view->frame_us == frame_us &&
+    view->frame_max_us == frame_max_us && view->shown->jitter_us == jitter_us && view->shown->ai_rate == ai_rate &&
+    view->shown->ai_us == ai_us)
+    return;
+  surfaces = view->surfaces;
+  bytes = view->bytes;
+  fps = view->fps;
+  frame_us = view->frame_us;
+  frame_max_us = view->frame_max_us;
+  jitter_us = view->shown->jitter_us;
+  ai_rate = view->shown->ai_rate;
+  ai_us = view->shown->ai_us;
+  n = snprintf(caption, sizeof(caption), "Tetris - %d surfaces, %ld KB - %d fps, frame %d.%02d ms (max %d.%02d), tick jitter %d.%02d ms",
+    surfaces, bytes / 1024, fps, frame_us / 1000, frame_us % 1000 / 10, frame_max_us / 1000, frame_max_us % 1000 / 10,
+    jitter_us / 1000, jitter_us % 1000 / 10);
+  if (view->count > 1 && n < (int) sizeof(caption))
+    n += snprintf(caption + n, sizeof(caption) - n, " - %d games", view->count);
+  if ((view->count > 1 || view->players[0].autoplay == 1) && n < (int) sizeof(caption))
+    snprintf(caption + n, sizeof(caption) - n, " - AI %ld placements/s, %d us/piece", ai_rate, ai_us);
+  SDL_WM_SetCaption(caption, "Tetris");
+}
+
+// accounts for a frame that just finished, and closes the second when it is over
+void view_timing(Uint64 frame_end) {
+  int i = 0;
+  // the simulation thread times its ticks itself
+  while (i < PHASES) {
+    if (i != PHASE_STEP) {
+      histogram_add(&view->phases[i], view->phase_ns[i]);
+      view->phase_ns[i] = 0;
     }
-  if (flip_checking(pos) == 1) {
-    if (game->falling->type == 1 || game->falling->type == 4 || game->falling->type == 6)
-      game->falling->angle ^= 1;
-    else
-      game->falling->angle += (clockwise == 0) ? -1 : 1;
-    if (game->falling->angle == -1)
-      game->falling->angle = 3;
-    if (game->falling->angle == 4)
-      game->falling->angle = 0;
-    game->falling->pos[0] = pos[0];
-    game->falling->pos[1] = pos[1];
-    game->falling->pos[2] = pos[2];
-    game->falling->pos[3] = pos[3];
+    ++i;
   }
+  histogram_add(&view->frames_ns, frame_end - view->last_frame);
+  histogram_add(&view->recent, frame_end - view->last_frame);
+  if (frame_end - view->last_frame > view->frame_max)
+    view->frame_max = frame_end - view->last_frame;
+  view->last_frame = frame_end;
+  ++view->frames;
+  if (frame_end - view->second_start < 1000000000)
+    return;
+  view->fps = view->frames * 1000000000LL / (frame_end - view->second_start);
+  view->frame_us = (frame_end - view->second_start) / view->frames / 1000;
+  view->frame_max_us = view->frame_max / 1000;
+  view->overlay_us[0] = histogram_percentile(&view->recent, 50) / 1000;
+  view->overlay_us[1] = histogram_percentile(&view->recent, 99) / 1000;
+  view->overlay_us[2] = view->recent.max / 1000;
+  histogram_clear(&view->recent);
+  view->second_start = frame_end;
+  view->frames = 0;
+  view->frame_max = 0;
 }
@@ -0,0 +1,68 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "triple.h"
+
+#define TRIPLE_FRESH 4
+
+// the slot the writer fills next
+void *triple_back(Triple *triple) {
+  return triple->slots + triple->back * triple->size;
+}
+
+void triple_free(Triple *triple) {
+  free(triple->slots);
+}
+
+// the snapshot the reader took last
+const void *triple_front(const Triple *triple) {
+  return triple->slots + triple->front * triple->size;
+}
+
+// three zeroed slots of size bytes each; -1 if there is no memory for them
+int triple_new(Triple *triple, size_t size) {
+  // slots a cache line apart, so the threads never write to the same line
+  triple->size = (size + 63) / 64 * 64;
+  if ((triple->slots = aligned_alloc(64, 3 * triple->size)) == NULL)
+    return -1;
+  memset(triple->slots, 0, 3 * triple->size);
+  triple->back = 0;
+  atomic_init(&triple->middle, 1);
+  triple->front = 2;
+  return 0;
+}
+
+// hands the back slot over; the writer goes on with whichever was in the middle
+void triple_publish(Triple *triple) {
+  triple->back = atomic_exchange_explicit(&triple->middle, triple->back | TRIPLE_FRESH, memory_order_acq_rel) & 3;
+}
+
+// 1 if a snapshot was published since the last take, and is now the front one
+int triple_take(Triple *triple) {
+  if ((atomic_load_explicit(&triple->middle, memory_order_relaxed) & TRIPLE_FRESH) == 0)
+    return 0;
+  triple->front = atomic_exchange_explicit(&triple->middle, triple->front, memory_order_acq_rel) & 3;
+  return 1;
+}
@@ -0,0 +1,54 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRIPLE_H
+#define TRIPLE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * The latest of a stream of snapshots, handed from one writer thread to one
+ * reader thread without either ever waiting. Of three slots, the writer
+ * fills its back one and triple_publish() swaps it with the middle one; the
+ * reader's triple_take() swaps its front one with the middle one when that
+ * holds a snapshot it has not seen. The front slot stays as it is until the
+ * reader takes again, however far the writer gets ahead.
+ */
+typedef struct Triple {
+  char *slots;
+  size_t size;
+  // the middle slot, with TRIPLE_FRESH set from a publish until the next take
+  atomic_int middle;
+  // each on its own cache line: the writer's slot and the reader's
+  _Alignas(64) int back;
+  _Alignas(64) int front;
+} Triple;
+
+void *triple_back(Triple *triple);
+void triple_free(Triple *triple);
+const void *triple_front(const Triple *triple);
+int triple_new(Triple *triple, size_t size);
+void triple_publish(Triple *triple);
+int triple_take(Triple *triple);
+
+#endif
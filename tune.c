@@ -0,0 +1,239 @@
+/*
+ * Tetris game
+ * Copyright (C) 2010 Julien Odent <julien at odent dot net>
+ *
+ * This game is an unofficial clone of the original
+ * Tetris game and is not endorsed by the
+ * registered trademark owners The Tetris Company, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tunes the AI's weights without a display. Every generation, candidate
+ * weight vectors are drawn around a mean, each plays the same set of seeded
+ * games, and the mean moves to the candidates that cleared the most lines
+ * (the cross-entropy method). Games run on a work-stealing thread pool;
+ * each one only depends on its seed and weights, so the results are the
+ * same whatever the number of threads.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "pool.h"
+
+typedef struct Batch {
+  Weights *candidates;
+  int games, pieces;
+  uint64_t seed;
+  int *lines;
+} Batch;
+
+static int compare(const void *a, const void *b);
+static double normal(uint64_t *state);
+static double now();
+static void play(void *arg, int i);
+static uint64_t splitmix(uint64_t *state);
+static void values(const Weights *w, double v[4]);
+static Weights weights(const double v[4]);
+
+static long *totals; // for compare(), the lines of each candidate
+
+int main(int argc, char **argv) {
+  Pool pool;
+  Batch batch;
+  Weights *candidates;
+  double mean[4], sd[4], v[4], elite[4], spread[4], start, seconds;
+  uint64_t state;
+  int *order;
+  int i, j, k, threads, generations, generation, count, nelite, n;
+  threads = sysconf(_SC_NPROCESSORS_ONLN);
+  generations = 10;
+  count = 32;
+  batch.games = 16;
+  batch.pieces = 500;
+  batch.seed = 1;
+  i = 1;
+  while (i < argc) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      generations = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      count = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+      batch.games = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+      batch.pieces = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      batch.seed = strtoull(argv[++i], NULL, 10);
+    else {
+      fprintf(stderr, "usage: %s [-j threads] [-n generations] [-c candidates] [-g games] [-p pieces] [-s seed]\n", argv[0]);
+      return 2;
+    }
+    ++i;
+  }
+  if (threads < 1 || count < 1 || batch.games < 1 || generations < 0) {
+    fprintf(stderr, "%s: threads, candidates and games must be positive\n", argv[0]);
+    return 2;
+  }
+  // with no generation to run, the built-in weights are measured instead
+  if (generations == 0)
+    count = 1;
+  candidates = malloc(count * sizeof(Weights));
+  totals = malloc(count * sizeof(long));
+  order = malloc(count * sizeof(int));
+  batch.candidates = candidates;
+  batch.lines = malloc(count * batch.games * sizeof(int));
+  if (candidates == NULL || totals == NULL || order == NULL || batch.lines == NULL) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    return 1;
+  }
+  if (pool_new(&pool, threads) != 0)
+    return 1;
+  printf("%d threads, %d candidates of %d games, at most %d pieces each\n", threads, count, batch.games, batch.pieces);
+  state = batch.seed;
+  nelite = (count >= 4) ? count / 4 : 1;
+  i = 0;
+  while (i < 4) {
+    mean[i] = 0;
+    sd[i++] = 1;
+  }
+  generation = 0;
+  do {
+    // the candidates are drawn here, in order, so threads cannot change them
+    if (generations == 0)
+      candidates[0] = ai_weights;
+    else {
+      i = 0;
+      while (i < count) {
+        j = 0;
+        while (j < 4) {
+          v[j] = mean[j] + sd[j] * normal(&state);
+          ++j;
+        }
+        candidates[i++] = weights(v);
+      }
+    }
+    start = now();
+    if (pool_run(&pool, count * batch.games, play, &batch) != 0) {
+      pool_free(&pool);
+      return 1;
+    }
+    seconds = now() - start;
+    i = 0;
+    while (i < count) {
+      totals[i] = 0;
+      j = 0;
+      while (j < batch.games)
+        totals[i] += batch.lines[i * batch.games + j++];
+      order[i] = i;
+      ++i;
+    }
+    qsort(order, count, sizeof(int), compare);
+    if (generations == 0) {
+      printf("%.1f lines per game, %.2f games/s\n", (double) totals[0] / batch.games, batch.games / seconds);
+      break;
+    }
+    // the next mean and spread are those of the elite, plus some noise that fades
+    memset(elite, 0, sizeof(elite));
+    memset(spread, 0, sizeof(spread));
+    k = 0;
+    while (k < nelite) {
+      values(&candidates[order[k++]], v);
+      i = 0;
+      while (i < 4) {
+        elite[i] += v[i];
+        spread[i] += v[i] * v[i];
+        ++i;
+      }
+    }
+    i = 0;
+    while (i < 4) {
+      mean[i] = elite[i] / nelite;
+      sd[i] = sqrt(fmax(spread[i] / nelite - mean[i] * mean[i], 0) + 0.1 / (generation + 1));
+      ++i;
+    }
+    n = count * batch.games;
+    printf("generation %d: best %.1f lines, elite mean { %f, %f, %f, %f }, %d games in %.2f s, %.2f games/s\n",
+      generation, (double) totals[order[0]] / batch.games, mean[0], mean[1], mean[2], mean[3], n, seconds, n / seconds);
+    fflush(stdout);
+    // every generation plays new games, the same ones for all of its candidates
+    batch.seed += batch.games;
+  } while (++generation < generations);
+  pool_free(&pool);
+  free(batch.lines);
+  free(order);
+  free(totals);
+  free(candidates);
+  return 0;
+}
+
+// most lines first, ties in candidate order so the sort is the same on every run
+static int compare(const void *a, const void *b) {
+  int i = *(const int *) a, j = *(const int *) b;
+  if (totals[i] != totals[j])
+    return (totals[i] > totals[j]) ? -1 : 1;
+  return i - j;
+}
+
+// a standard normal deviate (Box-Muller)
+static double normal(uint64_t *state) {
+  double u = (splitmix(state) >> 11) * (1.0 / 9007199254740992.0);
+  double v = (splitmix(state) >> 11) * (1.0 / 9007199254740992.0);
+  return sqrt(-2 * log(1 - u)) * cos(2 * M_PI * v);
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// one task of the pool: game i % games of candidate i / games
+static void play(void *arg, int i) {
+  Batch *batch = arg;
+  Game game;
+  game_new(&game, batch->seed + i % batch->games, RANDOM_BAG);
+  batch->lines[i] = ai_play(&game, &batch->candidates[i / batch->games], batch->pieces);
+}
+
+static uint64_t splitmix(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static void values(const Weights *w, double v[4]) {
+  v[0] = w->height;
+  v[1] = w->lines;
+  v[2] = w->holes;
+  v[3] = w->bumpiness;
+}
+
+static Weights weights(const double v[4]) {
+  Weights w;
+  w.height = v[0];
+  w.lines = v[1];
+  w.holes = v[2];
+  w.bumpiness = v[3];
+  return w;
+}